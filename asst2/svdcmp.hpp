@@ -1 +0,0 @@
-void svdcmp(double **a, int m, int n, double w[], double **v);
@@ -0,0 +1,342 @@
+#include <math.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ik3d.h"
+#include "iksvd.h"
+
+// the suffix kernel is written once against a lane type, one joint at a
+// time for the tail and four per register with sse
+struct ScalarLane3D {
+    typedef GLfloat Value;
+    static const int width = 1;
+
+    static Value load(const GLfloat *p) { return *p; }
+    static void store(GLfloat *p, Value a) { *p = a; }
+    static Value set(GLfloat a) { return a; }
+};
+
+#ifdef __SSE__
+struct SSELane3D {
+    struct Value {
+        __m128 r;
+
+        Value() {}
+        Value(__m128 r) : r(r) {}
+
+        Value operator+(Value b) const { return _mm_add_ps(r, b.r); }
+        Value operator-(Value b) const { return _mm_sub_ps(r, b.r); }
+        Value operator*(Value b) const { return _mm_mul_ps(r, b.r); }
+    };
+    static const int width = 4;
+
+    static Value load(const GLfloat *p) { return _mm_loadu_ps(p); }
+    static void store(GLfloat *p, Value a) { _mm_storeu_ps(p, a.r); }
+    static Value set(GLfloat a) { return _mm_set1_ps(a); }
+};
+#endif
+
+// composes r with the world rotation of joint k and rotates its base
+// about (cx, cy, cz) with m, the matrix of r
+template <typename L>
+static inline void rotateJoints(Skeleton3D &skel, int k, bool moveBase,
+        const GLfloat r[4], const GLfloat m[9], const GLfloat c[3]) {
+    typedef typename L::Value V;
+
+    V rw = L::set(r[0]), rx = L::set(r[1]), ry = L::set(r[2]), rz = L::set(r[3]);
+    V w = L::load(&skel.gw[k]);
+    V x = L::load(&skel.gx[k]);
+    V y = L::load(&skel.gy[k]);
+    V z = L::load(&skel.gz[k]);
+
+    L::store(&skel.gw[k], rw * w - rx * x - ry * y - rz * z);
+    L::store(&skel.gx[k], rw * x + rx * w + ry * z - rz * y);
+    L::store(&skel.gy[k], rw * y - rx * z + ry * w + rz * x);
+    L::store(&skel.gz[k], rw * z + rx * y - ry * x + rz * w);
+
+    if (!moveBase)
+        return;
+
+    V cx = L::set(c[0]), cy = L::set(c[1]), cz = L::set(c[2]);
+    V dx = L::load(&skel.px[k]) - cx;
+    V dy = L::load(&skel.py[k]) - cy;
+    V dz = L::load(&skel.pz[k]) - cz;
+
+    L::store(&skel.px[k], cx + L::set(m[0]) * dx + L::set(m[1]) * dy + L::set(m[2]) * dz);
+    L::store(&skel.py[k], cy + L::set(m[3]) * dx + L::set(m[4]) * dy + L::set(m[5]) * dz);
+    L::store(&skel.pz[k], cz + L::set(m[6]) * dx + L::set(m[7]) * dy + L::set(m[8]) * dz);
+}
+
+// rotation matrix of the unit quaternion q, row major
+static void toMatrix(const GLfloat q[4], GLfloat m[9]) {
+    GLfloat w = q[0], x = q[1], y = q[2], z = q[3];
+
+    m[0] = 1.f - 2.f * (y * y + z * z);
+    m[1] = 2.f * (x * y - w * z);
+    m[2] = 2.f * (x * z + w * y);
+    m[3] = 2.f * (x * y + w * z);
+    m[4] = 1.f - 2.f * (x * x + z * z);
+    m[5] = 2.f * (y * z - w * x);
+    m[6] = 2.f * (x * z - w * y);
+    m[7] = 2.f * (y * z + w * x);
+    m[8] = 1.f - 2.f * (x * x + y * y);
+}
+
+// quaternion turning by angle (radians) about the unit axis (x, y, z)
+static void axisAngle(GLfloat x, GLfloat y, GLfloat z, GLfloat angle, GLfloat q[4]) {
+    GLfloat s = sin(0.5f * angle);
+    q[0] = cos(0.5f * angle);
+    q[1] = x * s;
+    q[2] = y * s;
+    q[3] = z * s;
+}
+
+void Skeleton3D::addJoint(GLfloat w, GLfloat x, GLfloat y, GLfloat z, GLfloat len) {
+    qw.push_back(w);
+    qx.push_back(x);
+    qy.push_back(y);
+    qz.push_back(z);
+    length.push_back(len);
+
+    gw.resize(size());
+    gx.resize(size());
+    gy.resize(size());
+    gz.resize(size());
+    px.resize(size());
+    py.resize(size());
+    pz.resize(size());
+}
+
+Skeleton3D Skeleton3D::fromPlanar(const Skeleton &skel) {
+    Skeleton3D lifted;
+    lifted.root_x = skel.root_x;
+    lifted.root_y = skel.root_y;
+
+    std::list<Joint>::const_iterator joint;
+    for (joint = skel.joints.begin(); joint != skel.joints.end(); ++joint) {
+        GLfloat q[4];
+        axisAngle(0.f, 0.f, 1.f, joint->angle * M_PI / 180.f, q);
+        lifted.addJoint(q[0], q[1], q[2], q[3], joint->length);
+    }
+
+    lifted.computePositions();
+    return lifted;
+}
+
+void Skeleton3D::computePositions() {
+    GLfloat w = 1.f, x = 0.f, y = 0.f, z = 0.f;
+    GLfloat bx = root_x, by = root_y, bz = root_z;
+
+    for (int j = 0; j < size(); j++) {
+        // world = parent world * local
+        GLfloat nw = w * qw[j] - x * qx[j] - y * qy[j] - z * qz[j];
+        GLfloat nx = w * qx[j] + x * qw[j] + y * qz[j] - z * qy[j];
+        GLfloat ny = w * qy[j] - x * qz[j] + y * qw[j] + z * qx[j];
+        GLfloat nz = w * qz[j] + x * qy[j] - y * qx[j] + z * qw[j];
+        w = nw;
+        x = nx;
+        y = ny;
+        z = nz;
+
+        gw[j] = w;
+        gx[j] = x;
+        gy[j] = y;
+        gz[j] = z;
+        px[j] = bx;
+        py[j] = by;
+        pz[j] = bz;
+
+        // the bone is the frame's x axis
+        bx += length[j] * (1.f - 2.f * (y * y + z * z));
+        by += length[j] * 2.f * (x * y + w * z);
+        bz += length[j] * 2.f * (x * z - w * y);
+    }
+
+    end_x = bx;
+    end_y = by;
+    end_z = bz;
+}
+
+void Skeleton3D::computeRotations() {
+    GLfloat w = 1.f, x = 0.f, y = 0.f, z = 0.f;
+
+    for (int j = 0; j < size(); j++) {
+        GLfloat n = sqrtf(gw[j] * gw[j] + gx[j] * gx[j] + gy[j] * gy[j] + gz[j] * gz[j]);
+        gw[j] /= n;
+        gx[j] /= n;
+        gy[j] /= n;
+        gz[j] /= n;
+
+        // local = conjugate(parent world) * world
+        qw[j] = w * gw[j] + x * gx[j] + y * gy[j] + z * gz[j];
+        qx[j] = w * gx[j] - x * gw[j] - y * gz[j] + z * gy[j];
+        qy[j] = w * gy[j] + x * gz[j] - y * gw[j] - z * gx[j];
+        qz[j] = w * gz[j] - x * gy[j] + y * gx[j] - z * gw[j];
+
+        w = gw[j];
+        x = gx[j];
+        y = gy[j];
+        z = gz[j];
+    }
+}
+
+void Skeleton3D::rotateSuffix(int first, GLfloat rw, GLfloat rx, GLfloat ry, GLfloat rz) {
+    GLfloat r[4] = { rw, rx, ry, rz };
+    GLfloat m[9];
+    GLfloat c[3] = { px[first], py[first], pz[first] };
+    toMatrix(r, m);
+
+    // the base of joint first is the pivot, so only its rotation changes
+    rotateJoints<ScalarLane3D>(*this, first, false, r, m, c);
+
+    int k = first + 1;
+    int n = size();
+
+#ifdef __SSE__
+    for (; k + SSELane3D::width <= n; k += SSELane3D::width)
+        rotateJoints<SSELane3D>(*this, k, true, r, m, c);
+#endif
+
+    for (; k < n; k++)
+        rotateJoints<ScalarLane3D>(*this, k, true, r, m, c);
+
+    GLfloat dx = end_x - c[0];
+    GLfloat dy = end_y - c[1];
+    GLfloat dz = end_z - c[2];
+    end_x = c[0] + m[0] * dx + m[1] * dy + m[2] * dz;
+    end_y = c[1] + m[3] * dx + m[4] * dy + m[5] * dz;
+    end_z = c[2] + m[6] * dx + m[7] * dy + m[8] * dz;
+}
+
+void Skeleton3D::solveIKwithCCD(EndTarget3D target) {
+    for (int j = size() - 1; j >= 0; j--) {
+        // vectors from the joint to the end effector and the target
+        GLfloat ex = end_x - px[j], ey = end_y - py[j], ez = end_z - pz[j];
+        GLfloat tx = target.x - px[j], ty = target.y - py[j], tz = target.z - pz[j];
+
+        // shortest arc from one to the other
+        GLfloat ax = ey * tz - ez * ty;
+        GLfloat ay = ez * tx - ex * tz;
+        GLfloat az = ex * ty - ey * tx;
+        GLfloat al = sqrtf(ax * ax + ay * ay + az * az);
+
+        // already lined up (or on top of the joint)
+        if (al == 0.f)
+            continue;
+
+        GLfloat angle = atan2(al, ex * tx + ey * ty + ez * tz);
+
+        GLfloat q[4];
+        axisAngle(ax / al, ay / al, az / al, angle, q);
+        rotateSuffix(j, q[0], q[1], q[2], q[3]);
+    }
+
+    computeRotations();
+}
+
+void Skeleton3D::solveIKwithJacobian(EndTarget3D target, JacobianMethod method) {
+    int n = size();
+
+    // the columns of joint j are a x r for the world axes a, with r the
+    // vector from the joint to the end effector. so J^T e = r x e, and
+    // J J^T = sum of |r|^2 I - r r^T is always 3 x 3
+    double e[3] = { target.x - end_x, target.y - end_y, target.z - end_z };
+    double y[3] = { e[0], e[1], e[2] };
+
+    if (method != TRANSPOSE) {
+        std::vector<double> &jjt = work.jjt;
+        jjt.assign(9, 0.0);
+
+        for (int j = 0; j < n; j++) {
+            double r[3] = { end_x - px[j], end_y - py[j], end_z - pz[j] };
+            double rr = r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+
+            for (int a = 0; a < 3; a++)
+                for (int b = 0; b < 3; b++)
+                    jjt[a * 3 + b] += (a == b ? rr : 0.0) - r[a] * r[b];
+        }
+
+        work.jjinverse.resize(9);
+        pseudoInverse(&jjt[0], 3, 3, &work.jjinverse[0], SVD_TOL, work.svd);
+
+        for (int a = 0; a < 3; a++)
+            y[a] = work.jjinverse[a * 3] * e[0] + work.jjinverse[a * 3 + 1] * e[1] +
+                work.jjinverse[a * 3 + 2] * e[2];
+    }
+
+    // every joint's step is taken before any of them moves
+    std::vector<double> &dtheta = work.dtheta;
+    dtheta.resize(3 * n);
+    for (int j = 0; j < n; j++) {
+        double r[3] = { end_x - px[j], end_y - py[j], end_z - pz[j] };
+        dtheta[3 * j] = r[1] * y[2] - r[2] * y[1];
+        dtheta[3 * j + 1] = r[2] * y[0] - r[0] * y[2];
+        dtheta[3 * j + 2] = r[0] * y[1] - r[1] * y[0];
+    }
+
+    // like the planar solver, turn from the end back to the root
+    for (int j = n - 1; j >= 0; j--) {
+        double wx = dtheta[3 * j], wy = dtheta[3 * j + 1], wz = dtheta[3 * j + 2];
+        double wl = sqrt(wx * wx + wy * wy + wz * wz);
+        if (wl == 0.0)
+            continue;
+
+        GLfloat q[4];
+        axisAngle(wx / wl, wy / wl, wz / wl, JT_ALPHA * wl, q);
+        rotateSuffix(j, q[0], q[1], q[2], q[3]);
+    }
+
+    computeRotations();
+}
+
+bool Skeleton3D::stepIK(EndTarget3D target, IKMethod method) {
+    GLfloat ox = end_x, oy = end_y, oz = end_z;
+
+    switch (method) {
+        case IK_CCD:
+            solveIKwithCCD(target);
+            break;
+
+        case IK_TRANSPOSE:
+            solveIKwithJacobian(target, TRANSPOSE);
+            break;
+
+        default:
+            solveIKwithJacobian(target, PSEUDOINVERSE);
+            break;
+    }
+
+    GLfloat dx = target.x - end_x, dy = target.y - end_y, dz = target.z - end_z;
+    GLfloat sx = end_x - ox, sy = end_y - oy, sz = end_z - oz;
+
+    if (method == IK_CCD)
+        return sqrtf(dx * dx + dy * dy + dz * dz) < CCD_EPSILON;
+    return sqrtf(sx * sx + sy * sy + sz * sz) < JAC_EPSILON;
+}
+
+int Skeleton3D::solveIK(EndTarget3D target, IKMethod method) {
+    if (method != IK_CCD && method != IK_TRANSPOSE && method != IK_PSEUDOINVERSE)
+        return -1;
+
+    int i = 0;
+    int limit = iterationLimit(method);
+    while (i < limit) {
+        ++i;
+        if (stepIK(target, method))
+            break;
+    }
+
+    // the solvers move the bases incrementally in float, so rebuild them
+    // from the renormalized rotations before the next solve starts
+    computePositions();
+
+    return i;
+}
@@ -0,0 +1,74 @@
+/*
+ * ik3d.h
+ * ======
+ *
+ * chains in three dimensions: every joint is a ball joint holding a unit
+ * quaternion, and the bone runs along the x axis of the joint's frame.
+ * joints are stored as structure of arrays (one array per quaternion and
+ * position component), so the rotation of a whole chain suffix runs
+ * several joints per simd register. planar chains keep using Skeleton,
+ * which stays the fast path for 2D
+ *
+ */
+
+#ifndef _IK3D_H_
+#define _IK3D_H_
+
+#include <vector>
+
+#include "ikskel.h"
+
+struct EndTarget3D {
+    bool active = false;
+    GLfloat x = 0.f, y = 0.f, z = 0.f;
+};
+
+struct Skeleton3D {
+    // rotation of each joint relative to its parent's frame (the first
+    // joint's relative to the world)
+    std::vector<GLfloat> qw, qx, qy, qz;
+    std::vector<GLfloat> length;
+
+    // world rotations and bone bases, filled in by computePositions() and
+    // kept up to date by the solvers
+    std::vector<GLfloat> gw, gx, gy, gz;
+    std::vector<GLfloat> px, py, pz;
+
+    GLfloat root_x = 0.f, root_y = 0.f, root_z = 0.f;
+    GLfloat end_x = 0.f, end_y = 0.f, end_z = 0.f;
+
+    JacobianWorkspace work;
+
+    int size() const { return length.size(); }
+
+    // appends a joint rotated by the unit quaternion (w, x, y, z)
+    void addJoint(GLfloat w, GLfloat x, GLfloat y, GLfloat z, GLfloat len);
+
+    // lifts a planar chain into the z = 0 plane, its angles turning into
+    // rotations about z
+    static Skeleton3D fromPlanar(const Skeleton &skel);
+
+    void computePositions();
+
+    // recovers the relative rotations from the world ones once a solver
+    // has moved them, renormalizing away the drift
+    void computeRotations();
+
+    // turns joint first and everything after it by the unit quaternion r
+    // about the base of joint first
+    void rotateSuffix(int first, GLfloat rw, GLfloat rx, GLfloat ry, GLfloat rz);
+
+    void solveIKwithCCD(EndTarget3D target);
+
+    // TRANSPOSE and PSEUDOINVERSE, each joint gets three columns (one per
+    // world axis). BROYDEN is solved as PSEUDOINVERSE
+    void solveIKwithJacobian(EndTarget3D target, JacobianMethod method);
+
+    // same contract as Skeleton::stepIK() and Skeleton::solveIK(), for
+    // IK_CCD, IK_TRANSPOSE and IK_PSEUDOINVERSE. solveIK() returns -1 for
+    // the other methods
+    bool stepIK(EndTarget3D target, IKMethod method);
+    int solveIK(EndTarget3D target, IKMethod method);
+};
+
+#endif
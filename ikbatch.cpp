@@ -0,0 +1,327 @@
+#include <float.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikbatch.h"
+#include "ikskel.h"
+
+void SymBatch2::resize(int count) {
+    a00.resize(count);
+    a01.resize(count);
+    a11.resize(count);
+}
+
+void SymBatch3::resize(int count) {
+    a00.resize(count);
+    a01.resize(count);
+    a02.resize(count);
+    a11.resize(count);
+    a12.resize(count);
+    a22.resize(count);
+}
+
+// the kernels are written once against a lane type: plain doubles for
+// the scalar tail, and two doubles per register when sse2 is there. every
+// branch is a select, so all lanes follow the same path
+
+// one matrix at a time
+struct ScalarLane {
+    typedef double Value;
+    typedef bool Mask;
+    static const int width = 1;
+
+    static Value load(const double *p) { return *p; }
+    static void store(double *p, Value a) { *p = a; }
+    static Value set(double a) { return a; }
+    static Value root(Value a) { return sqrt(a); }
+    static Value magnitude(Value a) { return fabs(a); }
+    static Value larger(Value a, Value b) { return a > b ? a : b; }
+    static Mask atLeast(Value a, Value b) { return a >= b; }
+    static Value select(Mask m, Value a, Value b) { return m ? a : b; }
+    static Value signOf(Value a) { return a < 0.0 ? -1.0 : 1.0; }
+};
+
+#ifdef __SSE2__
+// two matrices per register
+struct SSE2Lane {
+    struct Value {
+        __m128d r;
+
+        Value() {}
+        Value(__m128d r) : r(r) {}
+
+        Value operator+(Value b) const { return _mm_add_pd(r, b.r); }
+        Value operator-(Value b) const { return _mm_sub_pd(r, b.r); }
+        Value operator*(Value b) const { return _mm_mul_pd(r, b.r); }
+        Value operator/(Value b) const { return _mm_div_pd(r, b.r); }
+        Value operator-() const { return _mm_sub_pd(_mm_setzero_pd(), r); }
+    };
+    typedef __m128d Mask;
+    static const int width = 2;
+
+    static Value load(const double *p) { return _mm_loadu_pd(p); }
+    static void store(double *p, Value a) { _mm_storeu_pd(p, a.r); }
+    static Value set(double a) { return _mm_set1_pd(a); }
+    static Value root(Value a) { return _mm_sqrt_pd(a.r); }
+    static Value magnitude(Value a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a.r); }
+    static Value larger(Value a, Value b) { return _mm_max_pd(a.r, b.r); }
+    static Mask atLeast(Value a, Value b) { return _mm_cmpge_pd(a.r, b.r); }
+    static Value select(Mask m, Value a, Value b) {
+        return _mm_or_pd(_mm_and_pd(m, a.r), _mm_andnot_pd(m, b.r));
+    }
+    static Value signOf(Value a) {
+        // -1 where the sign bit is set (-0 included), 1 elsewhere
+        return _mm_or_pd(_mm_and_pd(_mm_set1_pd(-0.0), a.r), _mm_set1_pd(1.0));
+    }
+};
+#endif
+
+// eigenvalues l1 >= l2 from the trace and the spread of the diagonal.
+// full rank inverts through the adjugate, rank one keeps only the l1
+// eigenspace, whose projector is (A - l2 I) / (l1 - l2)
+template <typename L>
+static void pseudoInvert2(SymBatch2 &batch, int k, typename L::Value tol) {
+    typedef typename L::Value V;
+
+    V a00 = L::load(&batch.a00[k]);
+    V a01 = L::load(&batch.a01[k]);
+    V a11 = L::load(&batch.a11[k]);
+
+    V half = L::set(0.5);
+    V zero = L::set(0.0);
+    V mean = (a00 + a11) * half;
+    V diff = (a00 - a11) * half;
+    V radius = L::root(diff * diff + a01 * a01);
+    V l1 = mean + radius;
+    V l2 = mean - radius;
+
+    typename L::Mask full = L::atLeast(l2, tol);
+    typename L::Mask single = L::atLeast(l1, tol);
+
+    // the denominators are kept away from zero, lanes they would blow up
+    // in are thrown away by the selects below
+    V tiny = L::set(DBL_MIN);
+    V det = L::larger(a00 * a11 - a01 * a01, tiny);
+    V scale = L::set(1.0) / L::larger(l1 * (l1 - l2), tiny);
+
+    L::store(&batch.a00[k], L::select(full, a11 / det, L::select(single, (a00 - l2) * scale, zero)));
+    L::store(&batch.a01[k], L::select(full, -a01 / det, L::select(single, a01 * scale, zero)));
+    L::store(&batch.a11[k], L::select(full, a00 / det, L::select(single, (a11 - l2) * scale, zero)));
+}
+
+// jacobi rotation zeroing a[p][q]. t = tan of the rotation angle, taken
+// in the stable form 2 apq sgn(tau) / (|tau| + sqrt(tau^2 + 4 apq^2))
+template <typename L>
+static inline void rotate3(typename L::Value *a, typename L::Value *v, int p, int q) {
+    typedef typename L::Value V;
+
+    int r = 3 - p - q;
+    V &app = a[p * 3 + p];
+    V &aqq = a[q * 3 + q];
+    V &apq = a[p * 3 + q];
+
+    V tau = aqq - app;
+    V denom = L::magnitude(tau) + L::root(tau * tau + L::set(4.0) * apq * apq);
+    V t = L::set(2.0) * apq * L::signOf(tau) / L::larger(denom, L::set(DBL_MIN));
+    V c = L::set(1.0) / L::root(t * t + L::set(1.0));
+    V s = t * c;
+
+    app = app - t * apq;
+    aqq = aqq + t * apq;
+    apq = L::set(0.0);
+    a[q * 3 + p] = apq;
+
+    V arp = a[r * 3 + p];
+    V arq = a[r * 3 + q];
+    a[r * 3 + p] = a[p * 3 + r] = c * arp - s * arq;
+    a[r * 3 + q] = a[q * 3 + r] = s * arp + c * arq;
+
+    for (int i = 0; i < 3; i++) {
+        V vip = v[i * 3 + p];
+        V viq = v[i * 3 + q];
+        v[i * 3 + p] = c * vip - s * viq;
+        v[i * 3 + q] = s * vip + c * viq;
+    }
+}
+
+// a fixed number of sweeps instead of a convergence test keeps every lane
+// in step, then A^+ = sum of v v^T / l over the kept eigenpairs
+template <typename L>
+static void pseudoInvert3(SymBatch3 &batch, int k, typename L::Value tol) {
+    typedef typename L::Value V;
+
+    V a[9], v[9];
+    a[0] = L::load(&batch.a00[k]);
+    a[1] = a[3] = L::load(&batch.a01[k]);
+    a[2] = a[6] = L::load(&batch.a02[k]);
+    a[4] = L::load(&batch.a11[k]);
+    a[5] = a[7] = L::load(&batch.a12[k]);
+    a[8] = L::load(&batch.a22[k]);
+
+    for (int i = 0; i < 9; i++)
+        v[i] = L::set(i % 4 == 0 ? 1.0 : 0.0);
+
+    for (int sweep = 0; sweep < BATCH_JACOBI_SWEEPS; sweep++) {
+        rotate3<L>(a, v, 0, 1);
+        rotate3<L>(a, v, 0, 2);
+        rotate3<L>(a, v, 1, 2);
+    }
+
+    V inv[3];
+    for (int e = 0; e < 3; e++) {
+        V l = a[e * 4];
+        inv[e] = L::select(L::atLeast(l, tol), L::set(1.0) / L::larger(l, L::set(DBL_MIN)), L::set(0.0));
+    }
+
+    V out[6];
+    const int rows[6] = { 0, 0, 0, 1, 1, 2 };
+    const int cols[6] = { 0, 1, 2, 1, 2, 2 };
+    for (int o = 0; o < 6; o++) {
+        int i = rows[o], j = cols[o];
+        out[o] = v[i * 3] * v[j * 3] * inv[0] +
+            v[i * 3 + 1] * v[j * 3 + 1] * inv[1] +
+            v[i * 3 + 2] * v[j * 3 + 2] * inv[2];
+    }
+
+    L::store(&batch.a00[k], out[0]);
+    L::store(&batch.a01[k], out[1]);
+    L::store(&batch.a02[k], out[2]);
+    L::store(&batch.a11[k], out[3]);
+    L::store(&batch.a12[k], out[4]);
+    L::store(&batch.a22[k], out[5]);
+}
+
+void pseudoInvertBatch(SymBatch2 &batch, double tol) {
+    int count = batch.size();
+    int k = 0;
+
+#ifdef __SSE2__
+    for (; k + SSE2Lane::width <= count; k += SSE2Lane::width)
+        pseudoInvert2<SSE2Lane>(batch, k, SSE2Lane::set(tol));
+#endif
+
+    for (; k < count; k++)
+        pseudoInvert2<ScalarLane>(batch, k, tol);
+}
+
+void pseudoInvertBatch(SymBatch3 &batch, double tol) {
+    int count = batch.size();
+    int k = 0;
+
+#ifdef __SSE2__
+    for (; k + SSE2Lane::width <= count; k += SSE2Lane::width)
+        pseudoInvert3<SSE2Lane>(batch, k, SSE2Lane::set(tol));
+#endif
+
+    for (; k < count; k++)
+        pseudoInvert3<ScalarLane>(batch, k, tol);
+}
+
+int solveIKCrowd(std::vector<Skeleton *> &skels, const std::vector<EndTarget> &targets) {
+    int count = skels.size();
+
+    // skeletons the analytic solver can't finish go to the batched loop,
+    // split by the dimension of their task space
+    std::vector<int> pending;
+    for (int k = 0; k < count; k++) {
+        if (!skels[k]->solveIKAnalytic(targets[k]))
+            pending.push_back(k);
+    }
+
+    SymBatch2 batch2;
+    SymBatch3 batch3;
+    std::vector<int> ids2, ids3;
+    std::vector<int> dims(count);
+
+    int i = 0;
+    for (; i < NUM_JAC_ITERS && !pending.empty(); ++i) {
+        ids2.clear();
+        ids3.clear();
+
+        for (int k : pending) {
+            Skeleton &skel = *skels[k];
+            dims[k] = skel.computeTaskError(targets[k]);
+            skel.buildJacobian(dims[k]);
+            skel.computeJJT(dims[k]);
+            (dims[k] == 3 ? ids3 : ids2).push_back(k);
+        }
+
+        batch2.resize(ids2.size());
+        for (size_t b = 0; b < ids2.size(); b++) {
+            const std::vector<double> &jjt = skels[ids2[b]]->work.jjt;
+            batch2.a00[b] = jjt[0];
+            batch2.a01[b] = jjt[1];
+            batch2.a11[b] = jjt[3];
+        }
+
+        batch3.resize(ids3.size());
+        for (size_t b = 0; b < ids3.size(); b++) {
+            const std::vector<double> &jjt = skels[ids3[b]]->work.jjt;
+            batch3.a00[b] = jjt[0];
+            batch3.a01[b] = jjt[1];
+            batch3.a02[b] = jjt[2];
+            batch3.a11[b] = jjt[4];
+            batch3.a12[b] = jjt[5];
+            batch3.a22[b] = jjt[8];
+        }
+
+        pseudoInvertBatch(batch2);
+        pseudoInvertBatch(batch3);
+
+        for (size_t b = 0; b < ids2.size(); b++) {
+            std::vector<double> &inverse = skels[ids2[b]]->work.jjinverse;
+            inverse.resize(4);
+            inverse[0] = batch2.a00[b];
+            inverse[1] = inverse[2] = batch2.a01[b];
+            inverse[3] = batch2.a11[b];
+        }
+
+        for (size_t b = 0; b < ids3.size(); b++) {
+            std::vector<double> &inverse = skels[ids3[b]]->work.jjinverse;
+            inverse.resize(9);
+            inverse[0] = batch3.a00[b];
+            inverse[1] = inverse[3] = batch3.a01[b];
+            inverse[2] = inverse[6] = batch3.a02[b];
+            inverse[4] = batch3.a11[b];
+            inverse[5] = inverse[7] = batch3.a12[b];
+            inverse[8] = batch3.a22[b];
+        }
+
+        // same step and stopping rule as solveIKwithJacobian() and stepIK()
+        std::vector<int> next;
+        for (int k : pending) {
+            Skeleton &skel = *skels[k];
+            int m = dims[k];
+            int n = skel.joints.size();
+
+            skel.composePseudoInverse(m, skel.work.pinv);
+
+            std::vector<double> &dtheta = skel.work.dtheta;
+            dtheta.assign(n, 0.0);
+            for (int j = 0; j < n; j++)
+                for (int c = 0; c < m; c++)
+                    dtheta[j] += skel.work.pinv[j * m + c] * skel.work.v[c];
+
+            GLfloat ox = skel.end.x;
+            GLfloat oy = skel.end.y;
+            skel.applyJointStep(dtheta);
+
+            GLfloat sx = skel.end.x - ox;
+            GLfloat sy = skel.end.y - oy;
+            if (sqrtf(sx * sx + sy * sy) >= JAC_EPSILON)
+                next.push_back(k);
+        }
+        pending.swap(next);
+    }
+
+    return i;
+}
@@ -0,0 +1,50 @@
+/*
+ * ikbatch.h
+ * =========
+ *
+ * batched pseudoinverses of many small symmetric matrices (the J J^T of a
+ * crowd of skeletons) kept in structure of arrays layout, so the same
+ * kernel runs on several matrices at once in simd registers
+ *
+ */
+
+#ifndef _IKBATCH_H_
+#define _IKBATCH_H_
+
+#include <vector>
+
+#include "ikskel.h"
+
+// number of jacobi sweeps the 3 x 3 eigen solver always runs, enough for
+// double precision on any symmetric 3 x 3 matrix
+#define BATCH_JACOBI_SWEEPS 5
+
+// element k of every array belongs to matrix k, only the upper triangle
+// of each symmetric matrix is stored
+struct SymBatch2 {
+    std::vector<double> a00, a01, a11;
+
+    void resize(int count);
+    int size() const { return a00.size(); }
+};
+
+struct SymBatch3 {
+    std::vector<double> a00, a01, a02, a11, a12, a22;
+
+    void resize(int count);
+    int size() const { return a00.size(); }
+};
+
+// replaces every matrix in the batch with its pseudoinverse, dropping
+// eigenvalues under tol like pseudoInverse() does. the matrices are
+// assumed positive semidefinite
+void pseudoInvertBatch(SymBatch2 &batch, double tol = SVD_TOL);
+void pseudoInvertBatch(SymBatch3 &batch, double tol = SVD_TOL);
+
+// runs the pseudoinverse method on a crowd of skeletons, skels[k] towards
+// targets[k], inverting the J J^T of every unfinished skeleton with one
+// batched call per iteration. each skeleton stops on its own under the
+// same rule as stepIK(). returns the number of iterations run
+int solveIKCrowd(std::vector<Skeleton *> &skels, const std::vector<EndTarget> &targets);
+
+#endif
@@ -0,0 +1,342 @@
+/*
+ * ikbench.cpp
+ * ===========
+ *
+ * headless benchmark of the fixed size solvers in each precision mode:
+ * time per solve and how far the solved pose is from the target when its
+ * angles are run through double precision forward kinematics. then a
+ * crowd of longer chains solved one at a time against the batched crowd
+ * pseudoinverse, the 3D solvers on targets all around the root, and
+ * quantized pose storage of a recorded motion at a few error bounds:
+ * worst decoding error, bytes per pose and decode time, and last the
+ * iterations a path of targets takes warm started from pose to pose
+ * against solving every target from the rest pose, and a parallel ccd
+ * chain long enough to split over a pool, solved directly and from
+ * multiple starts already running on that pool
+ *
+ */
+
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <random>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ik3d.h"
+#include "ikbatch.h"
+#include "ikfixed.h"
+#include "ikmulti.h"
+#include "ikpool.h"
+#include "ikquant.h"
+#include "ikskel.h"
+#include "iktraj.h"
+#include "iktune.h"
+
+// number of targets solved per configuration
+#define BENCH_TARGETS 20000
+#define BENCH_SEED 7
+
+// skeletons in the crowd and joints in each of them
+#define BENCH_CROWD 4000
+#define BENCH_CROWD_JOINTS 12
+
+// targets solved per 3D configuration
+#define BENCH_TARGETS_3D 2000
+
+// poses recorded for the quantized storage, tracking a target that goes
+// round BENCH_LAPS times
+#define BENCH_POSES 20000
+#define BENCH_LAPS 5
+
+// targets along the path solved warm started and cold, by a chain of
+// BENCH_PATH_JOINTS
+#define BENCH_PATH_SAMPLES 200
+#define BENCH_PATH_JOINTS 12
+
+// targets solved by a parallel ccd chain of BENCH_POOL_JOINTS (past
+// PCCD_PARALLEL_MIN, so it splits) on a pool of BENCH_POOL_THREADS
+#define BENCH_POOL_TARGETS 20
+#define BENCH_POOL_JOINTS 300
+#define BENCH_POOL_THREADS 4
+
+// distance from the solver's end effector to the one recomputed from its
+// angles in double, and from the recomputed one to the target
+static void trueResidual(Skeleton &skel, EndTarget target, double *fkError, double *residual) {
+    double x = skel.root_x;
+    double y = skel.root_y;
+    double a = 0.0;
+
+    std::list<Joint>::iterator joint;
+    for (joint = skel.joints.begin(); joint != skel.joints.end(); ++joint) {
+        a += joint->angle * M_PI / 180.0;
+        x += joint->length * cos(a);
+        y += joint->length * sin(a);
+    }
+
+    *fkError = sqrt((skel.end.x - x) * (skel.end.x - x) + (skel.end.y - y) * (skel.end.y - y));
+    *residual = sqrt((target.x - x) * (target.x - x) + (target.y - y) * (target.y - y));
+}
+
+int main(int argc, char **argv) {
+    const int lengths[] = { 4, 6, 8 };
+    const IKMethod methods[] = { IK_CCD, IK_TRANSPOSE, IK_PSEUDOINVERSE };
+    const Precision precisions[] = { PRECISION_FLOAT, PRECISION_DOUBLE, PRECISION_MIXED };
+
+    std::cout << "joints method precision us/solve iterations mean_residual max_fk_error" << std::endl;
+
+    for (int n : lengths) {
+        for (IKMethod method : methods) {
+            for (Precision precision : precisions) {
+                std::mt19937 rng(BENCH_SEED);
+                std::uniform_real_distribution<GLfloat> coord(-0.7f, 0.7f);
+
+                Skeleton skel = sampleChain(n);
+                skel.precision = precision;
+
+                double elapsed = 0.0, sum = 0.0, worst = 0.0;
+                long iters = 0;
+
+                // warm started from the previous target, like dragging
+                for (int k = 0; k < BENCH_TARGETS; k++) {
+                    // targets inside the reach of the chain
+                    EndTarget target;
+                    do {
+                        target.x = coord(rng);
+                        target.y = coord(rng);
+                    } while (target.x * target.x + target.y * target.y > 0.49f);
+
+                    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                    iters += solveIKFixed(skel, target, SolverConfig(method));
+                    elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+                    double fkError, residual;
+                    trueResidual(skel, target, &fkError, &residual);
+                    sum += residual;
+                    if (fkError > worst) worst = fkError;
+                }
+
+                std::cout << n << " \"" << methodName(method) << "\" " << precisionName(precision) << " " <<
+                    1e6 * elapsed / BENCH_TARGETS << " " << double(iters) / BENCH_TARGETS << " " <<
+                    sum / BENCH_TARGETS << " " << worst << std::endl;
+            }
+        }
+    }
+
+    std::cout << std::endl << "crowd oriented us/skeleton(single) us/skeleton(batched) max_difference" << std::endl;
+
+    for (int oriented = 0; oriented < 2; oriented++) {
+        std::mt19937 rng(BENCH_SEED);
+        std::uniform_real_distribution<GLfloat> coord(-0.7f, 0.7f);
+
+        std::vector<Skeleton> single(BENCH_CROWD, sampleChain(BENCH_CROWD_JOINTS));
+        std::vector<Skeleton> crowd(single);
+        std::vector<Skeleton *> members;
+        std::vector<EndTarget> targets(BENCH_CROWD);
+
+        for (int k = 0; k < BENCH_CROWD; k++) {
+            targets[k].x = coord(rng);
+            targets[k].y = coord(rng);
+            targets[k].oriented = oriented;
+            targets[k].angle = 180.f * coord(rng);
+            members.push_back(&crowd[k]);
+        }
+
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for (int k = 0; k < BENCH_CROWD; k++)
+            single[k].solveIK(targets[k], IK_PSEUDOINVERSE);
+        double singleElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        begin = std::chrono::steady_clock::now();
+        solveIKCrowd(members, targets);
+        double crowdElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        // both paths take the same steps, so the poses should agree
+        double worst = 0.0;
+        for (int k = 0; k < BENCH_CROWD; k++) {
+            double dx = single[k].end.x - crowd[k].end.x;
+            double dy = single[k].end.y - crowd[k].end.y;
+            worst = fmax(worst, sqrt(dx * dx + dy * dy));
+        }
+
+        std::cout << BENCH_CROWD << " " << oriented << " " << 1e6 * singleElapsed / BENCH_CROWD << " " <<
+            1e6 * crowdElapsed / BENCH_CROWD << " " << worst << std::endl;
+    }
+
+    std::cout << std::endl << "joints(3d) method us/solve iterations mean_residual" << std::endl;
+
+    const int lengths3D[] = { 8, 32 };
+    for (int n : lengths3D) {
+        for (IKMethod method : methods) {
+            std::mt19937 rng(BENCH_SEED);
+            std::uniform_real_distribution<GLfloat> coord(-0.7f, 0.7f);
+
+            Skeleton3D skel = Skeleton3D::fromPlanar(sampleChain(n));
+
+            double elapsed = 0.0, sum = 0.0;
+            long iters = 0;
+
+            for (int k = 0; k < BENCH_TARGETS_3D; k++) {
+                EndTarget3D target;
+                do {
+                    target.x = coord(rng);
+                    target.y = coord(rng);
+                    target.z = coord(rng);
+                } while (target.x * target.x + target.y * target.y + target.z * target.z > 0.49f);
+
+                std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+                iters += skel.solveIK(target, method);
+                elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+                double dx = target.x - skel.end_x;
+                double dy = target.y - skel.end_y;
+                double dz = target.z - skel.end_z;
+                sum += sqrt(dx * dx + dy * dy + dz * dz);
+            }
+
+            std::cout << n << " \"" << methodName(method) << "\" " << 1e6 * elapsed / BENCH_TARGETS_3D << " " <<
+                double(iters) / BENCH_TARGETS_3D << " " << sum / BENCH_TARGETS_3D << std::endl;
+        }
+    }
+
+    std::cout << std::endl << "joints max_error measured_error bytes/pose(float table track) " <<
+        "ns/pose(table track)" << std::endl;
+
+    const int lengthsQuant[] = { 8, 32 };
+    const GLfloat bounds[] = { 0.f, 0.01f, 0.1f };
+    for (int n : lengthsQuant) {
+        Skeleton skel = sampleChain(n);
+        std::vector<GLfloat> motion;
+        motion.reserve((size_t)BENCH_POSES * n);
+
+        for (int p = 0; p < BENCH_POSES; p++) {
+            GLfloat a = 2.f * M_PI * BENCH_LAPS * p / BENCH_POSES;
+            EndTarget target;
+            target.active = true;
+            target.x = 0.5f * cosf(a);
+            target.y = 0.3f * sinf(3.f * a);
+
+            skel.solveIK(target, IK_CCD);
+            Pose pose = skel.getPose();
+            motion.insert(motion.end(), pose.angles.begin(), pose.angles.end());
+        }
+
+        for (GLfloat bound : bounds) {
+            PoseQuantizer quantizer(n, bound);
+            PoseTable table(quantizer);
+            PoseTrack track(quantizer);
+            for (int p = 0; p < BENCH_POSES; p++) {
+                table.append(&motion[(size_t)p * n]);
+                track.append(&motion[(size_t)p * n]);
+            }
+
+            std::vector<GLfloat> angles(n);
+            double worst = 0.0;
+
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            for (int p = 0; p < BENCH_POSES; p++) {
+                table.decode(p, angles.data());
+            }
+            double tableElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+            begin = std::chrono::steady_clock::now();
+            PoseTrack::Cursor cursor = track.seek(0);
+            while (cursor.next(angles.data()))
+                ;
+            double trackElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+            // the track decodes to the same codes as the table
+            cursor = track.seek(0);
+            for (int p = 0; cursor.next(angles.data()); p++) {
+                for (int j = 0; j < n; j++) {
+                    double error = fabs(angles[j] - motion[(size_t)p * n + j]);
+                    worst = fmax(worst, fmin(error, 360.0 - error));
+                }
+            }
+
+            std::cout << n << " " << quantizer.maxError() << " " << worst << " " << n * sizeof(GLfloat) <<
+                " " << double(table.bytes()) / BENCH_POSES << " " << double(track.bytes()) / BENCH_POSES <<
+                " " << 1e9 * tableElapsed / BENCH_POSES << " " << 1e9 * trackElapsed / BENCH_POSES << std::endl;
+        }
+    }
+
+    std::cout << std::endl << "joints method iterations(warm cold) mean_residual(warm cold)" << std::endl;
+
+    // a spline through a few points in reach, sampled evenly and solved
+    // warm started along it, against each sample solved from the rest pose
+    std::vector<EndTarget> points(4);
+    const GLfloat pathXY[] = { 0.6f, 0.f, 0.2f, 0.5f, -0.4f, 0.3f, -0.5f, -0.3f };
+    for (int p = 0; p < 4; p++) {
+        points[p].active = true;
+        points[p].x = pathXY[2 * p];
+        points[p].y = pathXY[2 * p + 1];
+    }
+    std::vector<EndTarget> path = sampleTargetPath(points, BENCH_PATH_SAMPLES, PATH_SPLINE);
+
+    const IKMethod methodsPath[] = { IK_CCD, IK_PSEUDOINVERSE };
+    for (IKMethod method : methodsPath) {
+        Skeleton rest = sampleChain(BENCH_PATH_JOINTS);
+        std::vector<TrajectorySample> samples = solveTrajectory(rest, path, method);
+
+        long warm = 0, cold = 0;
+        double warmSum = 0.0, coldSum = 0.0;
+        for (size_t k = 0; k < path.size(); k++) {
+            warm += samples[k].iterations;
+            warmSum += samples[k].residual;
+
+            Skeleton skel = rest;
+            cold += skel.solveIK(path[k], method);
+            GLfloat dx = path[k].x - skel.end.x;
+            GLfloat dy = path[k].y - skel.end.y;
+            coldSum += sqrtf(dx * dx + dy * dy);
+        }
+
+        std::cout << BENCH_PATH_JOINTS << " \"" << methodName(method) << "\" " << warm << " " << cold << " " <<
+            warmSum / path.size() << " " << coldSum / path.size() << std::endl;
+    }
+
+    std::cout << std::endl << "joints threads us/solve(split multi_start) mean_residual(split multi_start)" << std::endl;
+
+    // a parallel ccd chain long enough to be split over the pool, solved
+    // on its own and from several starts that already run on that pool
+    {
+        ThreadPool pool(BENCH_POOL_THREADS);
+        Skeleton rest = sampleChain(BENCH_POOL_JOINTS);
+        rest.pool = &pool;
+
+        std::mt19937 rng(BENCH_SEED);
+        std::uniform_real_distribution<GLfloat> coord(-0.5f, 0.5f);
+
+        double split = 0.0, multi = 0.0, splitSum = 0.0, multiSum = 0.0;
+        for (int k = 0; k < BENCH_POOL_TARGETS; k++) {
+            EndTarget target;
+            target.active = true;
+            target.x = coord(rng);
+            target.y = coord(rng);
+
+            Skeleton skel = rest;
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            skel.solveIK(target, IK_PARALLEL_CCD);
+            split += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            splitSum += sqrt((target.x - skel.end.x) * (target.x - skel.end.x) +
+                    (target.y - skel.end.y) * (target.y - skel.end.y));
+
+            skel = rest;
+            begin = std::chrono::steady_clock::now();
+            solveIKMultiStart(skel, target, IK_PARALLEL_CCD, &pool);
+            multi += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            multiSum += sqrt((target.x - skel.end.x) * (target.x - skel.end.x) +
+                    (target.y - skel.end.y) * (target.y - skel.end.y));
+        }
+
+        std::cout << BENCH_POOL_JOINTS << " " << pool.size() << " " << 1e6 * split / BENCH_POOL_TARGETS << " " <<
+            1e6 * multi / BENCH_POOL_TARGETS << " " << splitSum / BENCH_POOL_TARGETS << " " <<
+            multiSum / BENCH_POOL_TARGETS << std::endl;
+    }
+
+    return 0;
+}
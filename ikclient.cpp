@@ -0,0 +1,287 @@
+/*
+ * ikclient.cpp
+ * ============
+ *
+ * load generator and stats reader for iksolverd
+ *
+ *   ikclient stats [socket]
+ *   ikclient solve <rig> <method> <requests> <targets> [depth] [deadline us] [socket]
+ *
+ * solve sends requests of random targets within CLIENT_REACH of the
+ * origin, keeping up to depth of them (default 1) unanswered at a time,
+ * and reports the round trip latencies and the daemon's stats. methods
+ * are ccd, transpose, pseudoinverse, fabrik, broyden, pccd or auto
+ * (the configuration the daemon tuned for the rig)
+ *
+ */
+
+#include <chrono>
+#include <errno.h>
+#include <iostream>
+#include <map>
+#include <math.h>
+#include <poll.h>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikproto.h"
+#include "ikskel.h"
+
+// targets are drawn from a disc of this radius around the origin, where
+// the rigs ikrig random writes are rooted
+#define CLIENT_REACH 0.7f
+#define CLIENT_SEED 11
+
+typedef std::chrono::steady_clock Clock;
+
+static const char *methodNames[] = { "ccd", "transpose", "pseudoinverse", "fabrik", "broyden", "pccd", "auto" };
+
+static int usage() {
+    std::cerr << "usage: ikclient stats [socket]" << std::endl <<
+        "       ikclient solve <rig> <method> <requests> <targets> [depth] [deadline us] [socket]" << std::endl;
+    return 2;
+}
+
+// a connection with buffers both ways, for a client that pipelines
+struct Client {
+    int fd = -1;
+    std::vector<char> in, out;
+    size_t sent = 0;
+
+    // waits until something can be sent or received and does it, returns
+    // false once the daemon has gone
+    bool pump() {
+        pollfd p = { fd, POLLIN, 0 };
+        if (sent < out.size())
+            p.events |= POLLOUT;
+
+        if (poll(&p, 1, -1) < 0)
+            return errno == EINTR;
+
+        if (p.revents & POLLOUT) {
+            ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+                return false;
+            if (n > 0)
+                sent += n;
+            if (sent == out.size()) {
+                out.clear();
+                sent = 0;
+            }
+        }
+
+        if (p.revents & (POLLIN | POLLHUP | POLLERR)) {
+            char buffer[65536];
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+                return false;
+            if (n > 0)
+                in.insert(in.end(), buffer, buffer + n);
+        }
+
+        return true;
+    }
+
+    // size of the whole frame at the start of in, 0 if there is none yet
+    long frame() {
+        long size = frameSize(in.data(), in.size());
+        return size > 0 ? size : 0;
+    }
+
+    void consume(long size) {
+        in.erase(in.begin(), in.begin() + size);
+    }
+};
+
+static void printStats(const ServiceStats &stats) {
+    std::cout << "daemon: " << stats.connections << " connections, " << stats.requests <<
+        " requests, " << stats.targets << " targets (" << stats.expired << " expired), " <<
+        stats.rejected << " rejected, " << stats.stalls << " stalls" << std::endl <<
+        "daemon latency us: p50 " << stats.p50 << " p90 " << stats.p90 << " p99 " << stats.p99 <<
+        " max " << stats.max << std::endl;
+}
+
+// asks for the daemon's stats and waits for them
+static bool fetchStats(Client &client, ServiceStats &stats) {
+    encodeFrame(client.out, PROTO_STATS, 0);
+
+    for (;;) {
+        long size = client.frame();
+        if (size) {
+            uint32_t kind, id;
+            frameHeader(client.in.data(), kind, id);
+            bool ok = kind == PROTO_STATS_REPLY && decodeStats(client.in.data(), size, stats);
+            client.consume(size);
+            if (ok)
+                return true;
+            if (kind != PROTO_RESULTS)
+                return false;
+        } else if (!client.pump()) {
+            return false;
+        }
+    }
+}
+
+static int attach(Client &client, const char *path) {
+    std::string error;
+    client.fd = connectUnix(path, error);
+    if (client.fd < 0) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static int stats(const char *path) {
+    Client client;
+    if (attach(client, path))
+        return 1;
+
+    ServiceStats current;
+    if (!fetchStats(client, current)) {
+        std::cerr << "no stats from " << path << std::endl;
+        return 1;
+    }
+
+    printStats(current);
+    return 0;
+}
+
+struct Pending {
+    uint32_t expected, received;
+    Clock::time_point sent;
+};
+
+static int solve(uint32_t rig, uint32_t method, int requests, int targets, int depth,
+        uint32_t deadline, const char *path) {
+    Client client;
+    if (attach(client, path))
+        return 1;
+
+    std::mt19937 rng(CLIENT_SEED);
+    std::uniform_real_distribution<GLfloat> unit(0.f, 1.f);
+
+    std::map<uint32_t, Pending> pending;
+    LatencyHistogram latency;
+    long solved = 0, expired = 0, errors = 0;
+    double residual = 0.0;
+    int next = 0, done = 0;
+
+    Clock::time_point begin = Clock::now();
+    while (done < requests) {
+        while ((int)pending.size() < depth && next < requests) {
+            SolveRequest request;
+            request.id = next++;
+            request.rig = rig;
+            request.method = method;
+            request.deadline = deadline;
+            for (int t = 0; t < targets; t++) {
+                GLfloat r = CLIENT_REACH * sqrtf(unit(rng));
+                GLfloat a = 2.f * M_PI * unit(rng);
+                request.targets.push_back(r * cosf(a));
+                request.targets.push_back(r * sinf(a));
+            }
+
+            encodeSolve(client.out, request);
+            Pending &entry = pending[request.id];
+            entry.expected = targets;
+            entry.received = 0;
+            entry.sent = Clock::now();
+        }
+
+        long size = client.frame();
+        if (!size) {
+            if (!client.pump()) {
+                std::cerr << "lost the connection to " << path << std::endl;
+                return 1;
+            }
+            continue;
+        }
+
+        uint32_t kind, id;
+        frameHeader(client.in.data(), kind, id);
+        std::map<uint32_t, Pending>::iterator entry = pending.find(id);
+
+        if (kind == PROTO_RESULTS && entry != pending.end()) {
+            SolveResults results;
+            if (!decodeResults(client.in.data(), size, results)) {
+                std::cerr << "malformed results for request " << id << std::endl;
+                return 1;
+            }
+
+            for (uint32_t t = 0; t < results.count; t++) {
+                if (results.state[t] == PROTO_EXPIRED) {
+                    ++expired;
+                } else {
+                    ++solved;
+                    residual += results.residual[t];
+                }
+            }
+
+            entry->second.received += results.count;
+            if (entry->second.received >= entry->second.expected) {
+                latency.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                            Clock::now() - entry->second.sent).count());
+                pending.erase(entry);
+                ++done;
+            }
+        } else if (kind == PROTO_ERROR && entry != pending.end()) {
+            std::string message;
+            decodeError(client.in.data(), size, message);
+            std::cerr << "request " << id << ": " << message << std::endl;
+            pending.erase(entry);
+            ++errors;
+            ++done;
+        } else {
+            std::cerr << "unexpected frame of kind " << kind << " for request " << id << std::endl;
+            return 1;
+        }
+
+        client.consume(size);
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    std::cout << requests << " requests of " << targets << " targets, " << depth << " in flight: " <<
+        solved << " solved, " << expired << " expired, " << errors << " rejected in " << elapsed <<
+        " s (" << (solved + expired) / elapsed << " targets/s), mean residual " <<
+        (solved ? residual / solved : 0.0) << std::endl <<
+        "round trip us: p50 " << latency.percentile(0.5) << " p90 " << latency.percentile(0.9) <<
+        " p99 " << latency.percentile(0.99) << " max " << latency.largest << std::endl;
+
+    ServiceStats current;
+    if (fetchStats(client, current))
+        printStats(current);
+    return errors ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && argc <= 3 && strcmp(argv[1], "stats") == 0)
+        return stats(argc == 3 ? argv[2] : PROTO_SOCKET);
+
+    if (argc >= 6 && argc <= 9 && strcmp(argv[1], "solve") == 0) {
+        int method = -1;
+        for (int m = 0; m <= IK_AUTO; m++) {
+            if (strcmp(argv[3], methodNames[m]) == 0)
+                method = m;
+        }
+        if (method < 0) {
+            std::cerr << "unknown method " << argv[3] << std::endl;
+            return usage();
+        }
+
+        return solve(atoi(argv[2]), method, atoi(argv[4]), atoi(argv[5]),
+                argc > 6 ? std::max(1, atoi(argv[6])) : 1, argc > 7 ? atoi(argv[7]) : 0,
+                argc > 8 ? argv[8] : PROTO_SOCKET);
+    }
+
+    return usage();
+}
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <math.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikcollide.h"
+#include "ikskel.h"
+
+CellRange SpatialHash::cover(GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1) const {
+    CellRange range;
+    range.x0 = floor(std::min(x0, x1) / cell);
+    range.y0 = floor(std::min(y0, y1) / cell);
+    range.x1 = floor(std::max(x0, x1) / cell);
+    range.y1 = floor(std::max(y0, y1) / cell);
+    return range;
+}
+
+std::vector<int> &SpatialHash::bucket(int cx, int cy) {
+    unsigned h = (unsigned)cx * 73856093u ^ (unsigned)cy * 19349663u;
+    return buckets[h & (buckets.size() - 1)];
+}
+
+void SpatialHash::insert(int id, const CellRange &range) {
+    for (int cx = range.x0; cx <= range.x1; cx++)
+        for (int cy = range.y0; cy <= range.y1; cy++)
+            bucket(cx, cy).push_back(id);
+}
+
+void SpatialHash::remove(int id, const CellRange &range) {
+    for (int cx = range.x0; cx <= range.x1; cx++) {
+        for (int cy = range.y0; cy <= range.y1; cy++) {
+            std::vector<int> &items = bucket(cx, cy);
+            std::vector<int>::iterator item = std::find(items.begin(), items.end(), id);
+            if (item != items.end()) {
+                *item = items.back();
+                items.pop_back();
+            }
+        }
+    }
+}
+
+void CollisionWorld::addObstacle(GLfloat x, GLfloat y, GLfloat r) {
+    Obstacle obstacle;
+    obstacle.x = x;
+    obstacle.y = y;
+    obstacle.radius = r;
+
+    statics.insert(obstacles.size(), statics.cover(x - r, y - r, x + r, y + r));
+    obstacles.push_back(obstacle);
+}
+
+void CollisionWorld::update(Skeleton &skel) {
+    int n = skel.joints.size();
+
+    // a different chain starts over, with cells sized to its bones so a
+    // cell holds a few of them however finely the chain is cut, and
+    // enough buckets that cells rarely share one
+    if ((int)boneCells.size() != n) {
+        GLfloat total = 0.f;
+        std::list<Joint>::iterator joint;
+        for (joint = skel.joints.begin(); joint != skel.joints.end(); ++joint)
+            total += joint->length;
+
+        int count = COLLIDE_BUCKETS;
+        while (count < 4 * n)
+            count *= 2;
+
+        bones.buckets.assign(count, std::vector<int>());
+        bones.cell = n ? std::max(2.f * total / n, 4.f * radius) : COLLIDE_CELL;
+        boneCells.assign(n, CellRange());
+        segments.resize(4 * n);
+        arc.resize(n + 1);
+    }
+
+    rehashed = 0;
+    arc[0] = 0.f;
+
+    int i = 0;
+    std::list<Joint>::iterator joint;
+    for (joint = skel.joints.begin(); joint != skel.joints.end(); ++joint) {
+        std::list<Joint>::iterator next = joint;
+        ++next;
+
+        GLfloat x0 = joint->x, y0 = joint->y;
+        GLfloat x1 = (next == skel.joints.end()) ? skel.end.x : next->x;
+        GLfloat y1 = (next == skel.joints.end()) ? skel.end.y : next->y;
+
+        segments[4 * i] = x0;
+        segments[4 * i + 1] = y0;
+        segments[4 * i + 2] = x1;
+        segments[4 * i + 3] = y1;
+        arc[i + 1] = arc[i] + joint->length;
+
+        // most bones stay in the same cells from one step to the next
+        CellRange range = bones.cover(std::min(x0, x1) - radius, std::min(y0, y1) - radius,
+                std::max(x0, x1) + radius, std::max(y0, y1) + radius);
+        if (!(range == boneCells[i])) {
+            bones.remove(i, boneCells[i]);
+            bones.insert(i, range);
+            boneCells[i] = range;
+            ++rehashed;
+        }
+
+        ++i;
+    }
+}
+
+static inline GLfloat clamp01(GLfloat x) {
+    return x < 0.f ? 0.f : (x > 1.f ? 1.f : x);
+}
+
+// squared distance between the segments p0-p1 and q0-q1
+static GLfloat segmentDistance2(const GLfloat *p, const GLfloat *q) {
+    GLfloat dx = p[2] - p[0], dy = p[3] - p[1];
+    GLfloat ex = q[2] - q[0], ey = q[3] - q[1];
+    GLfloat rx = p[0] - q[0], ry = p[1] - q[1];
+
+    GLfloat a = dx * dx + dy * dy;
+    GLfloat e = ex * ex + ey * ey;
+    GLfloat f = ex * rx + ey * ry;
+    GLfloat c = dx * rx + dy * ry;
+    GLfloat b = dx * ex + dy * ey;
+
+    // closest points at p0 + s d and q0 + t e, clamped to the segments
+    GLfloat s = 0.f, t = 0.f;
+    if (a > 0.f && e > 0.f) {
+        GLfloat denom = a * e - b * b;
+        s = (denom > 0.f) ? clamp01((b * f - c * e) / denom) : 0.f;
+        t = (b * s + f) / e;
+        if (t < 0.f) {
+            t = 0.f;
+            s = clamp01(-c / a);
+        } else if (t > 1.f) {
+            t = 1.f;
+            s = clamp01((b - c) / a);
+        }
+    } else if (a > 0.f) {
+        s = clamp01(-c / a);
+    } else if (e > 0.f) {
+        t = clamp01(f / e);
+    }
+
+    GLfloat x = rx + dx * s - ex * t;
+    GLfloat y = ry + dy * s - ey * t;
+    return x * x + y * y;
+}
+
+// squared distance from the point (x, y) to the segment p0-p1
+static GLfloat pointDistance2(const GLfloat *p, GLfloat x, GLfloat y) {
+    GLfloat dx = p[2] - p[0], dy = p[3] - p[1];
+    GLfloat len = dx * dx + dy * dy;
+    GLfloat s = (len > 0.f) ? clamp01(((x - p[0]) * dx + (y - p[1]) * dy) / len) : 0.f;
+
+    GLfloat rx = p[0] + dx * s - x;
+    GLfloat ry = p[1] + dy * s - y;
+    return rx * rx + ry * ry;
+}
+
+int CollisionWorld::countCollisions() {
+    int n = boneCells.size();
+    int count = 0;
+
+    if (marks.size() < std::max((size_t)n, obstacles.size()))
+        marks.assign(std::max((size_t)n, obstacles.size()), 0);
+
+    for (int i = 0; i < n; i++) {
+        const CellRange &range = boneCells[i];
+        const GLfloat *bone = &segments[4 * i];
+
+        // other bones, each pair counted once from its lower index
+        if (selfCollision) {
+            ++mark;
+            for (int cx = range.x0; cx <= range.x1; cx++) {
+                for (int cy = range.y0; cy <= range.y1; cy++) {
+                    std::vector<int> &items = bones.bucket(cx, cy);
+                    for (size_t k = 0; k < items.size(); k++) {
+                        int j = items[k];
+                        if (j <= i || marks[j] == mark)
+                            continue;
+
+                        // bones closer than a bone's thickness along the
+                        // chain touch whenever it folds
+                        if (arc[j] - arc[i + 1] < 2.f * radius)
+                            continue;
+                        marks[j] = mark;
+
+                        if (segmentDistance2(bone, &segments[4 * j]) < 4.f * radius * radius)
+                            ++count;
+                    }
+                }
+            }
+        }
+
+        if (obstacles.empty())
+            continue;
+
+        // the obstacles live in their own grid
+        CellRange cells = statics.cover(std::min(bone[0], bone[2]) - radius, std::min(bone[1], bone[3]) - radius,
+                std::max(bone[0], bone[2]) + radius, std::max(bone[1], bone[3]) + radius);
+
+        ++mark;
+        for (int cx = cells.x0; cx <= cells.x1; cx++) {
+            for (int cy = cells.y0; cy <= cells.y1; cy++) {
+                std::vector<int> &items = statics.bucket(cx, cy);
+                for (size_t k = 0; k < items.size(); k++) {
+                    int o = items[k];
+                    if (marks[o] == mark)
+                        continue;
+                    marks[o] = mark;
+
+                    const Obstacle &obstacle = obstacles[o];
+                    GLfloat reach = obstacle.radius + radius;
+                    if (pointDistance2(bone, obstacle.x, obstacle.y) < reach * reach)
+                        ++count;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+// angles part of the way from one pose to another, going the short way
+// around for each joint
+static void blendPose(const Pose &from, const Pose &to, GLfloat t, Pose &out) {
+    out.angles.resize(from.angles.size());
+    for (size_t j = 0; j < from.angles.size(); j++)
+        out.angles[j] = from.angles[j] + t * clamp(to.angles[j] - from.angles[j]);
+}
+
+int solveIKCollisionAware(Skeleton &skel, EndTarget target, IKMethod method,
+        CollisionWorld &world) {
+    world.update(skel);
+    int contacts = world.countCollisions();
+
+    Pose last, step, blended;
+
+    SolverConfig config = skel.configFor(method);
+
+    int i = 0;
+    while (i < config.iterations) {
+        ++i;
+
+        last = skel.getPose();
+        bool done = skel.stepIK(target, config);
+
+        // fabrik only moves positions, the blend needs its angles
+        if (config.method == IK_FABRIK)
+            skel.computeAngles();
+
+        world.update(skel);
+        int now = world.countCollisions();
+        if (now <= contacts) {
+            contacts = now;
+            if (done)
+                break;
+            continue;
+        }
+
+        // back off towards the last pose until the step is clear
+        step = skel.getPose();
+        GLfloat t = 1.f;
+        bool clear = false;
+        for (int b = 0; b < COLLIDE_BACKTRACK && !clear; b++) {
+            t *= 0.5f;
+            blendPose(last, step, t, blended);
+            skel.setPose(blended);
+            world.update(skel);
+            now = world.countCollisions();
+            clear = now <= contacts;
+        }
+
+        // the broyden estimate saw a step that was not taken
+        skel.broyden.age = -1;
+
+        if (!clear) {
+            skel.setPose(last);
+            world.update(skel);
+            break;
+        }
+        contacts = now;
+    }
+
+    return i;
+}
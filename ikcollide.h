@@ -0,0 +1,99 @@
+/*
+ * ikcollide.h
+ * ===========
+ *
+ * collision aware solving: bones are capsules kept in a uniform grid
+ * spatial hash, updated incrementally as the joints move, and checked
+ * against each other and against circular obstacles. only bones sharing
+ * a grid cell reach the narrow phase, so a check stays near linear in
+ * the number of bones
+ *
+ */
+
+#ifndef _IKCOLLIDE_H_
+#define _IKCOLLIDE_H_
+
+#include <vector>
+
+#include "ikskel.h"
+
+// side of an obstacle grid cell (bone grids are sized to the chain) and
+// number of hash buckets (a power of two)
+#define COLLIDE_CELL 0.1
+#define COLLIDE_BUCKETS 1024
+
+// half the thickness of a bone
+#define COLLIDE_RADIUS 0.01
+
+// times a colliding step is halved before the solve gives up on it
+#define COLLIDE_BACKTRACK 4
+
+struct Obstacle {
+    GLfloat x, y, radius;
+};
+
+// cells covered by the bounding box of a bone or obstacle
+struct CellRange {
+    int x0 = 0, y0 = 0, x1 = -1, y1 = -1;
+
+    bool operator==(const CellRange &other) const {
+        return x0 == other.x0 && y0 == other.y0 && x1 == other.x1 && y1 == other.y1;
+    }
+};
+
+// a uniform grid folded into a fixed number of buckets, so unbounded
+// scenes take constant memory. cells that share a bucket only produce
+// extra candidates, which the narrow phase throws away
+struct SpatialHash {
+    GLfloat cell = COLLIDE_CELL;
+    std::vector<std::vector<int> > buckets;
+
+    SpatialHash() : buckets(COLLIDE_BUCKETS) { }
+
+    CellRange cover(GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1) const;
+    std::vector<int> &bucket(int cx, int cy);
+
+    void insert(int id, const CellRange &range);
+    void remove(int id, const CellRange &range);
+};
+
+struct CollisionWorld {
+    std::vector<Obstacle> obstacles;
+    bool selfCollision = true;
+    GLfloat radius = COLLIDE_RADIUS;
+
+    // bones are hashed by index, bone i running from joint i to the next
+    // joint (or the end effector)
+    SpatialHash bones, statics;
+    std::vector<CellRange> boneCells;
+    std::vector<GLfloat> segments;
+
+    // distance along the chain to the start of each bone
+    std::vector<GLfloat> arc;
+
+    // bones that changed cells in the last update(), for profiling
+    int rehashed = 0;
+
+    void addObstacle(GLfloat x, GLfloat y, GLfloat radius);
+
+    // moves the bones of skel to their new cells, only touching the
+    // buckets of bones whose cells changed
+    void update(Skeleton &skel);
+
+    // number of bone/bone and bone/obstacle pairs in contact. bones less
+    // than two radii apart along the chain (neighbours always touch at
+    // their shared joint) are not counted
+    int countCollisions();
+
+    // stamps so a candidate found in several cells is tested once
+    std::vector<int> marks;
+    int mark = 0;
+};
+
+// solves like Skeleton::solveIK(), but a step that adds contacts is
+// halved up to COLLIDE_BACKTRACK times and dropped if it still does,
+// ending the solve there. returns the iterations used
+int solveIKCollisionAware(Skeleton &skel, EndTarget target, IKMethod method,
+        CollisionWorld &world);
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * ikexport.cpp
+ * ============
+ *
+ * renders solved sequences to numbered image files, without a window or
+ * an OpenGL context
+ *
+ *   ikexport solve <rigs.iklb> <rig> <frames> <directory> [ppm|png] [width] [height] [threads]
+ *   ikexport replay <rigs.iklb> <poses.ikps> <directory> [ppm|png] [width] [height] [threads]
+ *
+ * solve poses one copy of the rig per method (the auto one tuned first,
+ * as freezing it in the window does) and has every copy chase a target
+ * around a figure eight, warm started from the frame before. replay
+ * draws the poses main recorded with 'r' on the rig of a library saved
+ * with 'w', a frame for each round of skeletons. recordings have no
+ * targets, so none is drawn. frames are then drawn and written in
+ * parallel, each thread taking a run of them, as frame_000000.ppm (or
+ * .png) and on in the directory. images default to the window's
+ * 1024x768, and threads to one per core
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "iklib.h"
+#include "ikpool.h"
+#include "ikraster.h"
+#include "iksink.h"
+#include "ikskel.h"
+#include "iktune.h"
+
+#define EXPORT_WIDTH 1024
+#define EXPORT_HEIGHT 768
+
+// frames per lap of the figure eight, and how far out it goes as a
+// fraction of the rig's reach
+#define EXPORT_LAP_FRAMES 240
+#define EXPORT_REACH 0.8f
+
+typedef std::chrono::steady_clock Clock;
+
+// the poses of one frame: skeletons[k] (a method, which picks the color)
+// in poses[k]
+struct Frame {
+    EndTarget target;
+    std::vector<int> skeletons;
+    std::vector<Pose> poses;
+};
+
+static int usage() {
+    std::cerr << "usage: ikexport solve <rigs.iklb> <rig> <frames> <directory> [ppm|png] [width] [height] [threads]" <<
+        std::endl << "       ikexport replay <rigs.iklb> <poses.ikps> <directory> [ppm|png] [width] [height] [threads]" <<
+        std::endl;
+    return 2;
+}
+
+static bool loadRig(const char *path, int index, Skeleton &rest) {
+    SkeletonLibrary library;
+    std::string error;
+    if (!library.open(path, error)) {
+        std::cerr << error << std::endl;
+        return false;
+    }
+
+    RigView view;
+    if (!library.rig(index, view)) {
+        std::cerr << path << " has no rig " << index << std::endl;
+        return false;
+    }
+
+    rest = buildSkeleton(view);
+    return true;
+}
+
+static void solveFrames(const Skeleton &rest, int count, std::vector<Frame> &frames) {
+    std::vector<Skeleton> skeletons(IK_AUTO + 1, rest);
+    tuneSkeleton(skeletons[IK_AUTO]);
+
+    GLfloat reach = 0.f;
+    std::list<Joint>::const_iterator joint;
+    for (joint = rest.joints.begin(); joint != rest.joints.end(); ++joint)
+        reach += joint->length;
+
+    frames.resize(count);
+    for (int f = 0; f < count; f++) {
+        GLfloat a = 2.f * M_PI * f / EXPORT_LAP_FRAMES;
+
+        Frame &frame = frames[f];
+        frame.target.active = true;
+        frame.target.x = rest.root_x + EXPORT_REACH * reach * sinf(a);
+        frame.target.y = rest.root_y + 0.5f * EXPORT_REACH * reach * sinf(2.f * a);
+
+        for (int m = 0; m <= IK_AUTO; m++) {
+            skeletons[m].solveIK(frame.target, (IKMethod)m);
+            frame.skeletons.push_back(m);
+            frame.poses.push_back(skeletons[m].getPose());
+        }
+    }
+}
+
+static bool replayFrames(const char *path, std::vector<Frame> &frames) {
+    PoseReader reader;
+    std::string error;
+    if (!reader.open(path, error)) {
+        std::cerr << error << std::endl;
+        return false;
+    }
+
+    // main writes its skeletons in order after every solve, so a frame
+    // ends when the order starts over
+    PoseSample sample;
+    int last = IK_AUTO + 1;
+    while (reader.next(sample)) {
+        if (sample.skeleton > IK_AUTO)
+            continue;
+
+        if ((int)sample.skeleton <= last) {
+            frames.push_back(Frame());
+            frames.back().target.active = false;
+        }
+        last = sample.skeleton;
+
+        Pose pose;
+        pose.angles = sample.angles;
+        pose.end_x = sample.end_x;
+        pose.end_y = sample.end_y;
+        frames.back().skeletons.push_back(sample.skeleton);
+        frames.back().poses.push_back(pose);
+    }
+
+    return true;
+}
+
+// draws and writes every frame, returns the number that couldn't be
+// written
+static int render(const Skeleton &rest, const std::vector<Frame> &frames, const std::string &directory,
+        bool png, int width, int height, ThreadPool &pool) {
+    std::atomic<int> failed(0);
+
+    pool.parallelFor(0, frames.size(), [&](int begin, int end) {
+        Canvas canvas(width, height);
+        Skeleton skel = rest;
+        char name[32];
+
+        for (int f = begin; f < end; f++) {
+            canvas.clear(1.f, 1.f, 1.f);
+
+            const Frame &frame = frames[f];
+            for (size_t k = 0; k < frame.poses.size(); k++) {
+                skel.setPose(frame.poses[k]);
+                drawChain(canvas, skel, methodColors[frame.skeletons[k]]);
+            }
+            drawTarget(canvas, frame.target);
+
+            snprintf(name, sizeof(name), "/frame_%06d.%s", f, png ? "png" : "ppm");
+            std::string path = directory + name;
+            if (!(png ? writePNG(path.c_str(), canvas) : writePPM(path.c_str(), canvas)))
+                ++failed;
+        }
+    });
+
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    bool solve = argc >= 6 && argc <= 10 && strcmp(argv[1], "solve") == 0;
+    bool replay = argc >= 5 && argc <= 9 && strcmp(argv[1], "replay") == 0;
+    if (!solve && !replay)
+        return usage();
+
+    // the arguments after the directory are the same for both
+    int options = solve ? 6 : 5;
+    std::string directory = argv[options - 1];
+    bool png = false;
+    if (argc > options) {
+        png = strcmp(argv[options], "png") == 0;
+        if (!png && strcmp(argv[options], "ppm") != 0)
+            return usage();
+    }
+    int width = argc > options + 1 ? atoi(argv[options + 1]) : EXPORT_WIDTH;
+    int height = argc > options + 2 ? atoi(argv[options + 2]) : EXPORT_HEIGHT;
+    int threads = argc > options + 3 ? atoi(argv[options + 3]) : 0;
+    if (width <= 0 || height <= 0)
+        return usage();
+
+    int count = solve ? atoi(argv[4]) : 0;
+    if (solve && count <= 0)
+        return usage();
+
+    Skeleton rest;
+    if (!loadRig(argv[2], solve ? atoi(argv[3]) : 0, rest))
+        return 1;
+
+    Clock::time_point begin = Clock::now();
+    std::vector<Frame> frames;
+    if (solve)
+        solveFrames(rest, count, frames);
+    else if (!replayFrames(argv[3], frames))
+        return 1;
+    double solving = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    ThreadPool pool(threads);
+    begin = Clock::now();
+    int failed = render(rest, frames, directory, png, width, height, pool);
+    double rendering = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    std::cout << frames.size() << " frames " << (solve ? "solved" : "read") << " in " << solving <<
+        " s, drawn and written at " << width << "x" << height << " in " << rendering << " s (" <<
+        frames.size() / rendering << " frames/s on " << pool.size() << " threads)" << std::endl;
+
+    if (failed) {
+        std::cerr << "couldn't write " << failed << " frames to " << directory << std::endl;
+        return 1;
+    }
+    return 0;
+}
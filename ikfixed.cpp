@@ -0,0 +1,55 @@
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikfixed.h"
+
+template <int N, typename Policy>
+static int solveFixed(Skeleton &skel, EndTarget target, const SolverConfig &config,
+        const std::atomic<bool> *cancel) {
+    PolicySkeleton<N, Policy> fixed;
+    fixed.load(skel);
+
+    int iters = fixed.solve(target, config, cancel);
+
+    fixed.store(skel);
+    return iters;
+}
+
+template <typename Policy>
+static int solveForLength(Skeleton &skel, EndTarget target, const SolverConfig &config,
+        const std::atomic<bool> *cancel) {
+    // chains of three joints or fewer never get here, solveIKAnalytic()
+    // handles all of them first
+    switch (skel.joints.size()) {
+        case 4: return solveFixed<4, Policy>(skel, target, config, cancel);
+        case 6: return solveFixed<6, Policy>(skel, target, config, cancel);
+        case 8: return solveFixed<8, Policy>(skel, target, config, cancel);
+    }
+
+    return -1;
+}
+
+int solveIKFixed(Skeleton &skel, EndTarget target, const SolverConfig &config,
+        const std::atomic<bool> *cancel) {
+    if (config.method != IK_CCD && config.method != IK_TRANSPOSE && config.method != IK_PSEUDOINVERSE)
+        return -1;
+
+    // the active set and orientation targets only apply to the list
+    // based solver
+    if (skel.activeSetSize > 0 || target.oriented)
+        return -1;
+
+    switch (skel.precision) {
+        case PRECISION_FLOAT:
+            return solveForLength<FloatPrecision>(skel, target, config, cancel);
+        case PRECISION_DOUBLE:
+            return solveForLength<DoublePrecision>(skel, target, config, cancel);
+        case PRECISION_MIXED:
+            return solveForLength<MixedPrecision>(skel, target, config, cancel);
+    }
+
+    return -1;
+}
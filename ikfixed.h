@@ -0,0 +1,235 @@
+/*
+ * ikfixed.h
+ * =========
+ *
+ * skeletons with a joint count known at compile time: joints are kept in
+ * fixed size arrays and every per-joint loop of the solvers is unrolled,
+ * so a solve makes no allocations
+ *
+ */
+
+#ifndef _IKFIXED_H_
+#define _IKFIXED_H_
+
+#include <array>
+#include <cmath>
+
+#include "ikprecision.h"
+#include "ikskel.h"
+#include "iksvd.h"
+
+// calls f(I), f(I + 1), ..., f(N - 1), expanded at compile time
+template <int I, int N>
+struct Unroll {
+    template <typename F>
+    static inline void run(F &f) {
+        f(I);
+        Unroll<I + 1, N>::run(f);
+    }
+};
+
+template <int N>
+struct Unroll<N, N> {
+    template <typename F>
+    static inline void run(F &) { }
+};
+
+// calls f(N - 1), ..., f(0)
+template <int I, int N>
+struct UnrollReverse {
+    template <typename F>
+    static inline void run(F &f) {
+        f(N - 1 - I);
+        UnrollReverse<I + 1, N>::run(f);
+    }
+};
+
+template <int N>
+struct UnrollReverse<N, N> {
+    template <typename F>
+    static inline void run(F &) { }
+};
+
+// joints are stored as Scalar, while sums, trig and the jacobian are
+// carried out in Accum
+template <int N, typename Scalar, typename Accum = Scalar>
+struct FixedSkeleton {
+    // joint angles are in degrees, same as Joint
+    std::array<Scalar, N> angle, length, x, y;
+    Scalar root_x, root_y;
+    Scalar end_x, end_y;
+
+    void load(Skeleton &skel) {
+        root_x = skel.root_x;
+        root_y = skel.root_y;
+        end_x = skel.end.x;
+        end_y = skel.end.y;
+
+        std::list<Joint>::iterator joint = skel.joints.begin();
+        for (int j = 0; j < N; ++j, ++joint) {
+            angle[j] = joint->angle;
+            length[j] = joint->length;
+            x[j] = joint->x;
+            y[j] = joint->y;
+        }
+    }
+
+    // the positions always come from the angles here, so nothing drifted
+    void store(Skeleton &skel) {
+        skel.end.x = end_x;
+        skel.end.y = end_y;
+        skel.drift = 0.f;
+
+        std::list<Joint>::iterator joint = skel.joints.begin();
+        for (int j = 0; j < N; ++j, ++joint) {
+            joint->angle = angle[j];
+            joint->x = x[j];
+            joint->y = y[j];
+            joint->drift = 0.f;
+        }
+    }
+
+    void computePositions() {
+        Accum px = root_x;
+        Accum py = root_y;
+        Accum a = 0;
+
+        auto step = [&](int j) {
+            x[j] = px;
+            y[j] = py;
+
+            a += angle[j] * Accum(M_PI / 180.0);
+            px += length[j] * std::cos(a);
+            py += length[j] * std::sin(a);
+        };
+        Unroll<0, N>::run(step);
+
+        end_x = px;
+        end_y = py;
+    }
+
+    // a joint's position only depends on the joints before it, so going
+    // from the end only the end effector has to follow each rotation. the
+    // rest of the chain is placed once at the end of the sweep
+    void solveCCD(Accum tx, Accum ty) {
+        Accum ex = end_x;
+        Accum ey = end_y;
+
+        auto step = [&](int j) {
+            Accum re1 = ex - x[j];
+            Accum re2 = ey - y[j];
+
+            Accum ap = std::atan2(ty - y[j], tx - x[j]) - std::atan2(re2, re1);
+            Accum c = std::cos(ap);
+            Accum s = std::sin(ap);
+
+            angle[j] = clamp(ap * Accum(180.0 / M_PI) + angle[j]);
+
+            ex = re1 * c - re2 * s + x[j];
+            ey = re2 * c + re1 * s + y[j];
+        };
+        UnrollReverse<0, N>::run(step);
+
+        computePositions();
+    }
+
+    void solveJacobian(Accum tx, Accum ty, JacobianMethod method, Accum alpha = Accum(JT_ALPHA)) {
+        Accum v0 = tx - end_x;
+        Accum v1 = ty - end_y;
+
+        // jacobian columns are (-ry, rx) for the vector r from each joint
+        // to the end effector
+        std::array<Accum, N> j0, j1;
+        auto column = [&](int j) {
+            j0[j] = -(end_y - y[j]);
+            j1[j] = end_x - x[j];
+        };
+        Unroll<0, N>::run(column);
+
+        if (method == PSEUDOINVERSE) {
+            // dtheta = J^T (J J^T)^+ v, the 2x2 pseudoinverse comes from its
+            // eigen decomposition with eigenvalues under SVD_TOL dropped
+            Accum a = 0, b = 0, c = 0;
+            auto gram = [&](int j) {
+                a += j0[j] * j0[j];
+                b += j0[j] * j1[j];
+                c += j1[j] * j1[j];
+            };
+            Unroll<0, N>::run(gram);
+
+            Accum mean = (a + c) / 2;
+            Accum diff = (a - c) / 2;
+            Accum root = std::sqrt(diff * diff + b * b);
+
+            Accum w0 = 0, w1 = 0;
+            Accum lambda[2] = { mean + root, mean - root };
+            for (int k = 0; k < 2; k++) {
+                if (lambda[k] < Accum(SVD_TOL))
+                    continue;
+
+                // eigenvector of lambda[k]
+                Accum e0, e1;
+                if (std::fabs(b) > Accum(1e-12)) {
+                    e0 = b;
+                    e1 = lambda[k] - a;
+                } else {
+                    e0 = ((a >= c) == (k == 0)) ? 1 : 0;
+                    e1 = 1 - e0;
+                }
+
+                Accum norm = e0 * e0 + e1 * e1;
+                Accum proj = (e0 * v0 + e1 * v1) / (norm * lambda[k]);
+                w0 += proj * e0;
+                w1 += proj * e1;
+            }
+
+            v0 = w0;
+            v1 = w1;
+        }
+
+        auto update = [&](int j) {
+            angle[j] += alpha * (j0[j] * v0 + j1[j] * v1) * Accum(180.0 / M_PI);
+        };
+        Unroll<0, N>::run(update);
+
+        computePositions();
+    }
+
+    // same iteration limits and termination tests as Skeleton::stepIK
+    int solve(EndTarget target, const SolverConfig &config, const std::atomic<bool> *cancel) {
+        Accum tx = target.x;
+        Accum ty = target.y;
+        IKMethod method = config.method;
+
+        int i = 0;
+        while (i < config.iterations && !(cancel && *cancel)) {
+            Accum ox = end_x;
+            Accum oy = end_y;
+
+            if (method == IK_CCD)
+                solveCCD(tx, ty);
+            else
+                solveJacobian(tx, ty, method == IK_TRANSPOSE ? TRANSPOSE : PSEUDOINVERSE, Accum(config.alpha));
+            ++i;
+
+            Accum dx = (method == IK_CCD) ? tx - end_x : end_x - ox;
+            Accum dy = (method == IK_CCD) ? ty - end_y : end_y - oy;
+            if (std::sqrt(dx * dx + dy * dy) < Accum(config.epsilon))
+                break;
+        }
+
+        return i;
+    }
+};
+
+// fixed size skeleton for a precision policy
+template <int N, typename Policy>
+using PolicySkeleton = FixedSkeleton<N, typename Policy::Storage, typename Policy::Accum>;
+
+// solves skel with the fixed size solver matching its joint count (4, 6
+// or 8 joints) and precision for ccd, transpose and pseudoinverse.
+// returns the iterations used, or -1 if there is no fixed size solver
+int solveIKFixed(Skeleton &skel, EndTarget target, const SolverConfig &config,
+        const std::atomic<bool> *cancel = NULL);
+
+#endif
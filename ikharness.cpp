@@ -0,0 +1,479 @@
+/*
+ * ikharness.cpp
+ * =============
+ *
+ * quality versus time of the CCD, transpose and pseudoinverse solvers
+ *
+ *   ikharness report
+ *   ikharness write <baseline>
+ *   ikharness compare <baseline>
+ *
+ * every rig of the standard set (chains of 4 to 32 joints) solves every
+ * suite of targets (poses near the rest pose, and far from it) from its
+ * rest pose, once per iteration budget and once per deadline. each run
+ * records the mean time per solve and the mean and 95th percentile
+ * residual, and the runs no other run beats on both time and residual
+ * make up the pareto front of the rig and suite. write stores the runs as
+ * a baseline, compare flags runs that became less accurate on the same
+ * iteration budget (whether or not they got faster), and points of the
+ * baseline's iteration budget front the current runs no longer match
+ * within the slack, then exits with 1 if anything was flagged. against a
+ * deadline a timer thread cancels the solve, with a single core the
+ * timer has to wait its turn and short deadlines run late. the tracked
+ * baseline is ikharness.baseline, see the README
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <math.h>
+#include <mutex>
+#include <sstream>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikskel.h"
+#include "iktune.h"
+
+#define HARNESS_BASELINE "# ikharness baseline 1"
+
+// targets per suite, and the seed they are drawn with
+#define HARNESS_TARGETS 100
+#define HARNESS_SEED 5
+
+// times every run is repeated. with an iteration budget the fastest
+// repeat counts, against a deadline the one with the median residual
+#define HARNESS_REPEATS 5
+
+// every method terminates at the same distance, so only the budget
+// decides how close it gets
+#define HARNESS_EPSILON 0.0001
+
+// a solve within this distance counts as reaching its target
+#define HARNESS_TOLERANCE 0.01
+
+// how much slower and less accurate (both relative, plus absolute) than
+// the baseline a run may be before it is flagged
+#define HARNESS_TIME_SLACK 0.5
+#define HARNESS_TIME_FLOOR 0.5
+#define HARNESS_RESIDUAL_SLACK 0.05
+#define HARNESS_RESIDUAL_FLOOR 0.000001
+
+// iterations allowed against a deadline, only there so a solve that
+// never converges still ends if the timer can't get a turn
+#define HARNESS_DEADLINE_ITERATIONS 1000000
+
+typedef std::chrono::steady_clock Clock;
+
+// sets expired once the time it was armed for passes, unless disarmed
+// first, so a solve given &expired as its cancel flag stops there. it is
+// only woken when armed for earlier than it already sleeps until, a
+// timer left over from a disarm just finds nothing to do
+class DeadlineTimer {
+ public:
+    std::atomic<bool> expired;
+
+    DeadlineTimer() : expired(false), armed(false), sleeping(false), stopping(false) {
+        thread = std::thread(&DeadlineTimer::run, this);
+    }
+
+    ~DeadlineTimer() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_one();
+        thread.join();
+    }
+
+    void arm(Clock::time_point when) {
+        bool wake;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            expired = false;
+            due = when;
+            armed = true;
+            wake = !sleeping || when < wakeup;
+        }
+        if (wake)
+            changed.notify_one();
+    }
+
+    void disarm() {
+        std::lock_guard<std::mutex> guard(lock);
+        armed = false;
+    }
+
+ private:
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable changed;
+    Clock::time_point due, wakeup;
+    bool armed, sleeping, stopping;
+
+    void run() {
+        std::unique_lock<std::mutex> guard(lock);
+        while (!stopping) {
+            if (!armed) {
+                changed.wait(guard);
+            } else if (Clock::now() >= due) {
+                expired = true;
+                armed = false;
+            } else {
+                sleeping = true;
+                wakeup = due;
+                changed.wait_until(guard, wakeup);
+                sleeping = false;
+            }
+        }
+    }
+};
+
+struct Suite {
+    const char *name;
+
+    // each joint of a target pose is turned up to this many degrees from
+    // the rest pose
+    GLfloat spread;
+};
+
+static const int rigLengths[] = { 4, 8, 16, 32 };
+static const Suite suites[] = { { "near", 20.f }, { "far", 90.f } };
+static const IKMethod methods[] = { IK_CCD, IK_TRANSPOSE, IK_PSEUDOINVERSE };
+
+// one word each, so the baseline splits on spaces
+static const char *methodNames[] = { "ccd", "transpose", "pseudoinverse" };
+static const int budgets[] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+static const int deadlines[] = { 2, 5, 10, 20, 50, 100, 200, 500 };
+
+// iteration budgets, or deadlines in microseconds
+enum BudgetMode { BUDGET_ITERATIONS, BUDGET_DEADLINE };
+static const char *modeNames[] = { "iterations", "deadline" };
+
+struct Run {
+    std::string rig, suite, method;
+    int mode;
+    int budget;
+
+    double microseconds;
+    double residual, p95;
+    double reached;
+
+    std::string key() const {
+        std::ostringstream out;
+        out << rig << " " << suite << " " << method << " " << modeNames[mode] << " " << budget;
+        return out.str();
+    }
+};
+
+static int usage() {
+    std::cerr << "usage: ikharness report" << std::endl <<
+        "       ikharness write <baseline>" << std::endl <<
+        "       ikharness compare <baseline>" << std::endl;
+    return 2;
+}
+
+static GLfloat residual(const Skeleton &skel, EndTarget target) {
+    GLfloat dx = target.x - skel.end.x;
+    GLfloat dy = target.y - skel.end.y;
+    return sqrtf(dx * dx + dy * dy);
+}
+
+// solves every target from the rest pose within the budget, once
+static Run measureOnce(const Skeleton &rest, const std::vector<EndTarget> &targets, IKMethod method,
+        int mode, int budget, DeadlineTimer &timer) {
+    Skeleton skel = rest;
+    Pose start = skel.getPose();
+
+    SolverConfig config(method);
+    config.epsilon = HARNESS_EPSILON;
+    config.iterations = (mode == BUDGET_ITERATIONS) ? budget : HARNESS_DEADLINE_ITERATIONS;
+
+    std::vector<double> residuals;
+    double seconds = 0.0;
+    int reached = 0;
+
+    for (size_t t = 0; t < targets.size(); t++) {
+        skel.setPose(start);
+        skel.broyden = BroydenState();
+
+        // against a deadline the solve runs until it is close enough or
+        // the timer cancels it, so how late the timer fires counts too
+        Clock::time_point begin = Clock::now();
+        if (mode == BUDGET_ITERATIONS) {
+            skel.solveIK(targets[t], config);
+        } else {
+            timer.arm(begin + std::chrono::microseconds(budget));
+            skel.solveIK(targets[t], config, &timer.expired);
+            timer.disarm();
+        }
+        seconds += std::chrono::duration<double>(Clock::now() - begin).count();
+
+        residuals.push_back(residual(skel, targets[t]));
+        if (residuals.back() <= HARNESS_TOLERANCE)
+            ++reached;
+    }
+
+    Run run;
+    run.method = methodNames[method];
+    run.mode = mode;
+    run.budget = budget;
+    run.microseconds = 1e6 * seconds / targets.size();
+    run.reached = double(reached) / targets.size();
+
+    run.residual = 0.0;
+    for (double r : residuals)
+        run.residual += r;
+    run.residual /= residuals.size();
+
+    std::sort(residuals.begin(), residuals.end());
+    run.p95 = residuals[std::min(residuals.size() - 1, (size_t)(0.95 * residuals.size()))];
+    return run;
+}
+
+static Run measure(const Skeleton &rest, const std::vector<EndTarget> &targets, IKMethod method,
+        int mode, int budget, DeadlineTimer &timer) {
+    std::vector<Run> repeats;
+    for (int r = 0; r < HARNESS_REPEATS; r++)
+        repeats.push_back(measureOnce(rest, targets, method, mode, budget, timer));
+
+    if (mode == BUDGET_ITERATIONS) {
+        return *std::min_element(repeats.begin(), repeats.end(), [](const Run &a, const Run &b) {
+            return a.microseconds < b.microseconds;
+        });
+    }
+
+    std::sort(repeats.begin(), repeats.end(), [](const Run &a, const Run &b) {
+        return a.residual < b.residual;
+    });
+    return repeats[repeats.size() / 2];
+}
+
+static std::vector<Run> measureAll() {
+    std::vector<Run> runs;
+    DeadlineTimer timer;
+
+    for (int n : rigLengths) {
+        Skeleton rest = sampleChain(n);
+        std::string rig = "chain" + std::to_string(n);
+
+        for (const Suite &suite : suites) {
+            std::vector<EndTarget> targets = sampleTargets(rest, HARNESS_TARGETS, HARNESS_SEED, suite.spread);
+
+            for (IKMethod method : methods) {
+                for (int mode = BUDGET_ITERATIONS; mode <= BUDGET_DEADLINE; mode++) {
+                    for (int b = 0; b < 8; b++) {
+                        Run run = measure(rest, targets, method, mode,
+                                mode == BUDGET_ITERATIONS ? budgets[b] : deadlines[b], timer);
+                        run.rig = rig;
+                        run.suite = suite.name;
+                        runs.push_back(run);
+                    }
+                }
+            }
+        }
+    }
+
+    return runs;
+}
+
+// the runs of one rig and suite (of one mode, or of both if mode is
+// negative) that no other run of them beats on both time and mean
+// residual, fastest first
+static std::vector<Run> paretoFront(const std::vector<Run> &runs, const std::string &rig,
+        const std::string &suite, int mode = -1) {
+    std::vector<Run> group;
+    for (const Run &run : runs) {
+        if (run.rig == rig && run.suite == suite && (mode < 0 || run.mode == mode))
+            group.push_back(run);
+    }
+
+    std::sort(group.begin(), group.end(), [](const Run &a, const Run &b) {
+        return a.microseconds < b.microseconds ||
+            (a.microseconds == b.microseconds && a.residual < b.residual);
+    });
+
+    std::vector<Run> front;
+    for (const Run &run : group) {
+        if (front.empty() || run.residual < front.back().residual)
+            front.push_back(run);
+    }
+    return front;
+}
+
+static void printRun(const Run &run) {
+    std::cout << run.rig << " " << run.suite << " " << run.method << " " << modeNames[run.mode] <<
+        " " << run.budget << " " << run.microseconds << " " << run.residual << " " << run.p95 << " " <<
+        run.reached << std::endl;
+}
+
+static void report(const std::vector<Run> &runs) {
+    std::cout << "rig suite method mode budget us/solve mean_residual p95_residual reached" << std::endl;
+    for (const Run &run : runs)
+        printRun(run);
+
+    for (int n : rigLengths) {
+        for (const Suite &suite : suites) {
+            std::string rig = "chain" + std::to_string(n);
+            std::cout << std::endl << "pareto front " << rig << " " << suite.name << std::endl;
+            for (const Run &run : paretoFront(runs, rig, suite.name))
+                printRun(run);
+        }
+    }
+}
+
+static bool writeBaseline(const char *path, const std::vector<Run> &runs) {
+    std::ofstream out(path);
+    if (!out)
+        return false;
+
+    out << HARNESS_BASELINE << std::endl;
+    out.precision(9);
+    for (const Run &run : runs) {
+        out << run.key() << " " << run.microseconds << " " << run.residual << " " << run.p95 << " " <<
+            run.reached << std::endl;
+    }
+    return bool(out);
+}
+
+static bool readBaseline(const char *path, std::vector<Run> &runs, std::string &error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = std::string("can't read ") + path;
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(in, line) || line != HARNESS_BASELINE) {
+        error = std::string(path) + " is not an ikharness baseline";
+        return false;
+    }
+
+    for (int number = 2; std::getline(in, line); number++) {
+        if (line.empty())
+            continue;
+
+        std::istringstream fields(line);
+        Run run;
+        std::string mode;
+        fields >> run.rig >> run.suite >> run.method >> mode >> run.budget >> run.microseconds >>
+            run.residual >> run.p95 >> run.reached;
+
+        run.mode = (mode == modeNames[BUDGET_DEADLINE]) ? BUDGET_DEADLINE : BUDGET_ITERATIONS;
+        if (!fields || (mode != modeNames[BUDGET_ITERATIONS] && mode != modeNames[BUDGET_DEADLINE])) {
+            error = std::string(path) + ":" + std::to_string(number) + ": malformed run";
+            return false;
+        }
+        runs.push_back(run);
+    }
+
+    return true;
+}
+
+static bool worse(double residual, double baseline) {
+    return residual > baseline * (1.0 + HARNESS_RESIDUAL_SLACK) + HARNESS_RESIDUAL_FLOOR;
+}
+
+// the number of regressions against the baseline
+static int compare(const std::vector<Run> &runs, const std::vector<Run> &baseline) {
+    std::map<std::string, const Run *> current;
+    for (const Run &run : runs)
+        current[run.key()] = &run;
+
+    int flagged = 0;
+    std::cout << std::endl << "compared with the baseline" << std::endl;
+
+    // a fixed number of iterations lands on the same residual every time,
+    // whatever the machine, so any change there is the solver's
+    for (const Run &base : baseline) {
+        if (base.mode != BUDGET_ITERATIONS)
+            continue;
+
+        std::map<std::string, const Run *>::iterator found = current.find(base.key());
+        if (found == current.end())
+            continue;
+
+        const Run &run = *found->second;
+        if (worse(run.residual, base.residual) || worse(run.p95, base.p95)) {
+            bool faster = run.microseconds < base.microseconds * (1.0 - HARNESS_TIME_SLACK) - HARNESS_TIME_FLOOR;
+            std::cout << (faster ? "faster but less accurate: " : "less accurate: ") << run.key() <<
+                " residual " << base.residual << " -> " << run.residual << " p95 " << base.p95 << " -> " <<
+                run.p95 << " us " << base.microseconds << " -> " << run.microseconds << std::endl;
+            ++flagged;
+        }
+    }
+
+    // every point of the old front of the iteration budgets has to be
+    // matched by a current run that is about as fast and about as
+    // accurate. the residuals reached by a deadline depend on how busy
+    // the machine was, so they are only reported
+    for (int n : rigLengths) {
+        for (const Suite &suite : suites) {
+            std::string rig = "chain" + std::to_string(n);
+            std::vector<Run> front = paretoFront(runs, rig, suite.name, BUDGET_ITERATIONS);
+
+            for (const Run &base : paretoFront(baseline, rig, suite.name, BUDGET_ITERATIONS)) {
+                bool matched = false;
+                for (const Run &run : front) {
+                    if (run.microseconds <= base.microseconds * (1.0 + HARNESS_TIME_SLACK) + HARNESS_TIME_FLOOR &&
+                            !worse(run.residual, base.residual))
+                        matched = true;
+                }
+
+                if (!matched) {
+                    std::cout << "front receded: " << base.key() << " (" << base.microseconds << " us, residual " <<
+                        base.residual << ") is no longer reached" << std::endl;
+                    ++flagged;
+                }
+            }
+        }
+    }
+
+    std::cout << flagged << " regressions" << std::endl;
+    return flagged;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "report") == 0) {
+        report(measureAll());
+        return 0;
+    }
+
+    if (argc == 3 && strcmp(argv[1], "write") == 0) {
+        std::vector<Run> runs = measureAll();
+        report(runs);
+        if (!writeBaseline(argv[2], runs)) {
+            std::cerr << "can't write " << argv[2] << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (argc == 3 && strcmp(argv[1], "compare") == 0) {
+        std::vector<Run> baseline;
+        std::string error;
+        if (!readBaseline(argv[2], baseline, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+
+        std::vector<Run> runs = measureAll();
+        report(runs);
+        return compare(runs, baseline) ? 1 : 0;
+    }
+
+    return usage();
+}
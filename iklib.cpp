@@ -0,0 +1,244 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <math.h>
+#include <sstream>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "iklib.h"
+#include "ikskel.h"
+
+// most problems validate() describes before only counting the rest
+#define IKLIB_MAX_ERRORS 20
+
+static uint64_t alignUp(uint64_t offset) {
+    return (offset + IKLIB_ALIGN - 1) / IKLIB_ALIGN * IKLIB_ALIGN;
+}
+
+SkeletonLibrary::SkeletonLibrary() : data(NULL), bytes(0), header(NULL) { }
+
+SkeletonLibrary::~SkeletonLibrary() {
+    close();
+}
+
+void SkeletonLibrary::close() {
+    if (data)
+        munmap((void *)data, bytes);
+
+    data = NULL;
+    bytes = 0;
+    header = NULL;
+}
+
+bool SkeletonLibrary::open(const char *path, std::string &error) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        error = std::string("can't open ") + path + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(LibraryHeader)) {
+        error = std::string(path) + " is too small to be a skeleton library";
+        ::close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        error = std::string("can't map ") + path + ": " + strerror(errno);
+        return false;
+    }
+
+    data = (const char *)map;
+    bytes = info.st_size;
+    header = (const LibraryHeader *)data;
+
+    std::ostringstream problem;
+    if (memcmp(header->magic, IKLIB_MAGIC, 4) != 0) {
+        problem << "not a skeleton library";
+    } else if (header->byteOrder != IKLIB_BYTE_ORDER) {
+        problem << "written with the other byte order";
+    } else if (header->version != IKLIB_VERSION) {
+        problem << "version " << header->version << ", expected " << IKLIB_VERSION;
+    } else if (header->fileSize != bytes) {
+        problem << "header says " << header->fileSize << " bytes, file has " << bytes;
+    } else {
+        // every section has to be aligned and fit in the file
+        const uint64_t offsets[5] = { header->rigOffset, header->lengthOffset, header->angleOffset,
+            header->minAngleOffset, header->maxAngleOffset };
+        const uint64_t sizes[5] = { (uint64_t)header->rigCount * sizeof(LibraryRig),
+            (uint64_t)header->jointCount * sizeof(GLfloat), (uint64_t)header->jointCount * sizeof(GLfloat),
+            (uint64_t)header->jointCount * sizeof(GLfloat), (uint64_t)header->jointCount * sizeof(GLfloat) };
+
+        for (int s = 0; s < 5; s++) {
+            if (offsets[s] % IKLIB_ALIGN != 0 || offsets[s] < sizeof(LibraryHeader) ||
+                    offsets[s] > bytes || sizes[s] > bytes - offsets[s]) {
+                problem << "section " << s << " is misaligned or runs past the end of the file";
+                break;
+            }
+        }
+    }
+
+    if (!problem.str().empty()) {
+        error = std::string(path) + ": " + problem.str();
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+int SkeletonLibrary::size() const {
+    return header ? header->rigCount : 0;
+}
+
+bool SkeletonLibrary::rig(int index, RigView &view) const {
+    if (!header || index < 0 || index >= (int)header->rigCount)
+        return false;
+
+    const LibraryRig &rig = ((const LibraryRig *)(data + header->rigOffset))[index];
+
+    // checked here rather than in open(), which would have to walk every rig
+    if (rig.firstJoint > header->jointCount || rig.jointCount > header->jointCount - rig.firstJoint)
+        return false;
+
+    view.count = rig.jointCount;
+    view.root_x = rig.root_x;
+    view.root_y = rig.root_y;
+    view.length = (const GLfloat *)(data + header->lengthOffset) + rig.firstJoint;
+    view.angle = (const GLfloat *)(data + header->angleOffset) + rig.firstJoint;
+    view.minAngle = (const GLfloat *)(data + header->minAngleOffset) + rig.firstJoint;
+    view.maxAngle = (const GLfloat *)(data + header->maxAngleOffset) + rig.firstJoint;
+    return true;
+}
+
+int SkeletonLibrary::validate(std::vector<std::string> &errors) const {
+    int problems = 0;
+
+    for (int r = 0; r < size(); r++) {
+        std::ostringstream problem;
+        RigView view;
+
+        if (!rig(r, view)) {
+            problem << "rig " << r << " has joints outside the joint arrays";
+        } else if (!isfinite(view.root_x) || !isfinite(view.root_y)) {
+            problem << "rig " << r << " has a root that is not finite";
+        } else {
+            for (int j = 0; j < view.count && problem.str().empty(); j++) {
+                if (!isfinite(view.length[j]) || view.length[j] <= 0.f)
+                    problem << "rig " << r << " joint " << j << " has length " << view.length[j];
+                else if (!isfinite(view.minAngle[j]) || !isfinite(view.maxAngle[j]) ||
+                        view.minAngle[j] > view.maxAngle[j])
+                    problem << "rig " << r << " joint " << j << " has limits [" <<
+                        view.minAngle[j] << ", " << view.maxAngle[j] << "]";
+                else if (!isfinite(view.angle[j]) || view.angle[j] < view.minAngle[j] ||
+                        view.angle[j] > view.maxAngle[j])
+                    problem << "rig " << r << " joint " << j << " rests at " << view.angle[j] <<
+                        ", outside its limits";
+            }
+        }
+
+        if (!problem.str().empty()) {
+            if (problems < IKLIB_MAX_ERRORS)
+                errors.push_back(problem.str());
+            ++problems;
+        }
+    }
+
+    return problems;
+}
+
+Skeleton buildSkeleton(const RigView &view) {
+    Skeleton skel;
+    skel.root_x = view.root_x;
+    skel.root_y = view.root_y;
+
+    for (int j = 0; j < view.count; j++)
+        skel.joints.push_back(Joint(0.f, 0.f, view.angle[j], view.length[j]));
+
+    skel.computePositions();
+    skel.end.active = true;
+    skel.freezeSkeleton();
+    return skel;
+}
+
+void RigDescription::addJoint(GLfloat len, GLfloat rest, GLfloat lower, GLfloat upper) {
+    length.push_back(len);
+    angle.push_back(rest);
+    minAngle.push_back(lower);
+    maxAngle.push_back(upper);
+}
+
+RigDescription describeSkeleton(const Skeleton &skel) {
+    RigDescription rig;
+    rig.root_x = skel.root_x;
+    rig.root_y = skel.root_y;
+
+    std::list<Joint>::const_iterator joint;
+    for (joint = skel.joints.begin(); joint != skel.joints.end(); ++joint)
+        rig.addJoint(joint->length, clamp(joint->angle));
+
+    return rig;
+}
+
+bool writeSkeletonLibrary(const char *path, const std::vector<RigDescription> &rigs) {
+    LibraryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IKLIB_MAGIC, 4);
+    header.version = IKLIB_VERSION;
+    header.byteOrder = IKLIB_BYTE_ORDER;
+    header.rigCount = rigs.size();
+
+    std::vector<LibraryRig> table(rigs.size());
+    for (size_t r = 0; r < rigs.size(); r++) {
+        table[r].firstJoint = header.jointCount;
+        table[r].jointCount = rigs[r].length.size();
+        table[r].root_x = rigs[r].root_x;
+        table[r].root_y = rigs[r].root_y;
+        header.jointCount += rigs[r].length.size();
+    }
+
+    uint64_t floats = (uint64_t)header.jointCount * sizeof(GLfloat);
+    header.rigOffset = alignUp(sizeof(LibraryHeader));
+    header.lengthOffset = alignUp(header.rigOffset + table.size() * sizeof(LibraryRig));
+    header.angleOffset = alignUp(header.lengthOffset + floats);
+    header.minAngleOffset = alignUp(header.angleOffset + floats);
+    header.maxAngleOffset = alignUp(header.minAngleOffset + floats);
+    header.fileSize = alignUp(header.maxAngleOffset + floats);
+
+    std::vector<char> image(header.fileSize, 0);
+    memcpy(&image[0], &header, sizeof(header));
+    if (!table.empty())
+        memcpy(&image[header.rigOffset], &table[0], table.size() * sizeof(LibraryRig));
+
+    // each field of every rig goes into its own section
+    const uint64_t offsets[4] = { header.lengthOffset, header.angleOffset,
+        header.minAngleOffset, header.maxAngleOffset };
+    for (size_t r = 0; r < rigs.size(); r++) {
+        const std::vector<GLfloat> *fields[4] = { &rigs[r].length, &rigs[r].angle,
+            &rigs[r].minAngle, &rigs[r].maxAngle };
+
+        for (int f = 0; f < 4; f++) {
+            if (!fields[f]->empty())
+                memcpy(&image[offsets[f] + table[r].firstJoint * sizeof(GLfloat)],
+                        &(*fields[f])[0], fields[f]->size() * sizeof(GLfloat));
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(&image[0], image.size());
+    return file.good();
+}
@@ -0,0 +1,110 @@
+/*
+ * iklib.h
+ * =======
+ *
+ * binary skeleton libraries: a versioned file of rigs (root, bone lengths,
+ * rest angles and angle limits) laid out as aligned structure of arrays
+ * sections, so a library is mapped into memory and read in place. opening
+ * one only checks its header, whatever the number of rigs in it
+ *
+ */
+
+#ifndef _IKLIB_H_
+#define _IKLIB_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "ikskel.h"
+
+#define IKLIB_MAGIC "IKLB"
+#define IKLIB_VERSION 1
+
+// written as a plain integer, reads back differently on a machine with
+// the other byte order
+#define IKLIB_BYTE_ORDER 0x01020304u
+
+// every section starts on a cache line
+#define IKLIB_ALIGN 64
+
+struct LibraryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t rigCount;
+    uint32_t jointCount;
+    uint32_t reserved;
+
+    // LibraryRig[rigCount], then one float[jointCount] per joint field
+    uint64_t rigOffset;
+    uint64_t lengthOffset;
+    uint64_t angleOffset;
+    uint64_t minAngleOffset;
+    uint64_t maxAngleOffset;
+
+    uint64_t fileSize;
+};
+
+// a rig owns joints [firstJoint, firstJoint + jointCount) of the arrays
+struct LibraryRig {
+    uint32_t firstJoint;
+    uint32_t jointCount;
+    GLfloat root_x, root_y;
+};
+
+// one rig straight out of the mapped file, angles in degrees like Joint
+struct RigView {
+    int count;
+    GLfloat root_x, root_y;
+    const GLfloat *length;
+    const GLfloat *angle;
+    const GLfloat *minAngle;
+    const GLfloat *maxAngle;
+};
+
+class SkeletonLibrary {
+ public:
+    SkeletonLibrary();
+    ~SkeletonLibrary();
+
+    // maps path and checks its header. on failure returns false and
+    // describes the problem in error
+    bool open(const char *path, std::string &error);
+    void close();
+
+    int size() const;
+    bool rig(int index, RigView &view) const;
+
+    // every check the header can't cover: rig ranges, finite values,
+    // positive lengths and rest angles inside their limits. returns the
+    // number of problems, the first few described in errors
+    int validate(std::vector<std::string> &errors) const;
+
+ private:
+    const char *data;
+    size_t bytes;
+    const LibraryHeader *header;
+
+    SkeletonLibrary(const SkeletonLibrary &);
+    SkeletonLibrary &operator=(const SkeletonLibrary &);
+};
+
+// a frozen skeleton in the rest pose of a rig
+Skeleton buildSkeleton(const RigView &view);
+
+// a rig on its way into a library
+struct RigDescription {
+    GLfloat root_x = 0.f, root_y = 0.f;
+    std::vector<GLfloat> length, angle, minAngle, maxAngle;
+
+    void addJoint(GLfloat len, GLfloat rest, GLfloat lower = -180.f, GLfloat upper = 180.f);
+};
+
+// the current pose of skel as a rig without limits
+RigDescription describeSkeleton(const Skeleton &skel);
+
+// returns false if path can't be written
+bool writeSkeletonLibrary(const char *path, const std::vector<RigDescription> &rigs);
+
+#endif
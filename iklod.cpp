@@ -0,0 +1,105 @@
+#include <math.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "iklod.h"
+
+Skeleton coarsenSkeleton(Skeleton &skel) {
+    Skeleton coarse;
+    coarse.active = skel.active;
+    coarse.frozen = skel.frozen;
+    coarse.end = skel.end;
+    coarse.root_x = skel.root_x;
+    coarse.root_y = skel.root_y;
+
+    int j = 0;
+    std::list<Joint>::iterator joint;
+    for (joint = skel.joints.begin(); joint != skel.joints.end(); ++joint, ++j) {
+        if (j % LOD_MERGE == 0)
+            coarse.joints.push_back(Joint(joint->x, joint->y, 0.f, 0.f));
+    }
+
+    // each proxy bone runs from its first merged joint to the next proxy
+    // joint (or the end effector)
+    std::list<Joint>::iterator proxy;
+    for (proxy = coarse.joints.begin(); proxy != coarse.joints.end(); ++proxy) {
+        std::list<Joint>::iterator next = proxy;
+        ++next;
+
+        GLfloat nx = (next == coarse.joints.end()) ? coarse.end.x : next->x;
+        GLfloat ny = (next == coarse.joints.end()) ? coarse.end.y : next->y;
+
+        GLfloat dx = nx - proxy->x;
+        GLfloat dy = ny - proxy->y;
+        proxy->length = sqrtf(dx * dx + dy * dy);
+    }
+
+    coarse.computeAngles();
+    return coarse;
+}
+
+// world space angle (degrees) of every bone
+static std::vector<GLfloat> boneAngles(Skeleton &skel) {
+    std::vector<GLfloat> angles;
+    GLfloat a = 0.f;
+
+    std::list<Joint>::iterator joint;
+    for (joint = skel.joints.begin(); joint != skel.joints.end(); ++joint) {
+        a += joint->angle;
+        angles.push_back(a);
+    }
+
+    return angles;
+}
+
+int solveIKMultiResolution(Skeleton &skel, EndTarget target, IKMethod method) {
+    // levels[0] is skel itself, each following level is coarser
+    std::vector<Skeleton> levels;
+    levels.push_back(skel);
+    while ((int)levels.back().joints.size() >= LOD_MIN_JOINTS)
+        levels.push_back(coarsenSkeleton(levels.back()));
+
+    // the proxy bone angles each level was built with
+    std::vector<std::vector<GLfloat> > built(levels.size());
+    for (size_t l = 1; l < levels.size(); l++)
+        built[l] = boneAngles(levels[l]);
+
+    int iters = levels.back().solveIK(target, method);
+
+    for (int l = levels.size() - 2; l >= 0; l--) {
+        Skeleton &fine = levels[l];
+        std::vector<GLfloat> solved = boneAngles(levels[l + 1]);
+
+        // rotate each group of merged joints by how much its proxy bone
+        // turned. only the first joint of a group changes its angle, the
+        // rest of the group keeps its shape relative to it
+        GLfloat lastTurn = 0.f;
+        int j = 0;
+        std::list<Joint>::iterator joint;
+        for (joint = fine.joints.begin(); joint != fine.joints.end(); ++joint, ++j) {
+            if (j % LOD_MERGE != 0)
+                continue;
+
+            int g = j / LOD_MERGE;
+            GLfloat turn = solved[g] - built[l + 1][g];
+            joint->angle = clamp(joint->angle + turn - lastTurn);
+            lastTurn = turn;
+        }
+
+        fine.computePositions();
+        iters += fine.solveIK(target, method);
+    }
+
+    // only the joints were solved, keep the rest of the skeleton's state
+    // but the drift they carry
+    skel.joints = levels[0].joints;
+    skel.end = levels[0].end;
+    skel.drift = levels[0].drift;
+    skel.anchors = levels[0].anchors;
+    skel.anchoredJoints = levels[0].anchoredJoints;
+    return iters;
+}
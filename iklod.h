@@ -0,0 +1,30 @@
+/*
+ * iklod.h
+ * =======
+ *
+ * multi-resolution solving: long chains are solved first as coarse proxy
+ * chains made by merging consecutive joints, then refined level by level
+ *
+ */
+
+#ifndef _IKLOD_H_
+#define _IKLOD_H_
+
+#include "ikskel.h"
+
+// number of consecutive joints merged into each proxy joint
+#define LOD_MERGE 4
+
+// chains with fewer joints than this are not coarsened any further
+#define LOD_MIN_JOINTS 8
+
+// builds a proxy chain whose joints span LOD_MERGE joints of skel, with
+// bones along the chords between the merged joints
+Skeleton coarsenSkeleton(Skeleton &skel);
+
+// solves the coarsest proxy chain with method, then rigidly rotates the
+// merged joints of each finer level onto the coarser solution and refines
+// it. returns the iterations used over all levels
+int solveIKMultiResolution(Skeleton &skel, EndTarget target, IKMethod method);
+
+#endif
@@ -0,0 +1,95 @@
+#include <math.h>
+#include <random>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikmulti.h"
+
+struct StartResult {
+    Pose pose;
+    GLfloat residual;
+    int iterations;
+    bool finished;
+};
+
+int solveIKMultiStart(Skeleton &skel, EndTarget target, IKMethod method,
+        ThreadPool *pool, int starts, unsigned seed) {
+    if (starts < 1)
+        starts = 1;
+
+    // draw every perturbation up front so they don't depend on which
+    // thread runs which start. start 0 is the current pose
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<GLfloat> spread(-MULTI_START_SPREAD, MULTI_START_SPREAD);
+
+    Pose current = skel.getPose();
+    std::vector<Pose> seeds(starts, current);
+    for (int k = 1; k < starts; k++) {
+        for (size_t j = 0; j < seeds[k].angles.size(); j++)
+            seeds[k].angles[j] = clamp(seeds[k].angles[j] + spread(rng));
+    }
+
+    // once a start reaches the tolerance every later start is cancelled,
+    // earlier ones keep going since they would win if they get there too
+    std::vector<StartResult> results(starts);
+    std::unique_ptr<std::atomic<bool>[]> cancel(new std::atomic<bool>[starts]);
+    for (int k = 0; k < starts; k++) {
+        cancel[k] = false;
+        results[k].finished = false;
+    }
+
+    auto body = [&](int lo, int hi) {
+        for (int k = lo; k < hi; k++) {
+            if (cancel[k])
+                continue;
+
+            // the starts already share out the pool, one of them splitting a
+            // parallel ccd chain over it again would only queue behind them
+            Skeleton start = skel;
+            start.pool = NULL;
+            start.setPose(seeds[k]);
+
+            StartResult &result = results[k];
+            result.iterations = start.solveIK(target, method, &cancel[k]);
+            if (cancel[k])
+                continue;
+
+            GLfloat dx = target.x - start.end.x;
+            GLfloat dy = target.y - start.end.y;
+            result.residual = sqrtf(dx * dx + dy * dy);
+            result.pose = start.getPose();
+            result.finished = true;
+
+            if (result.residual < MULTI_START_TOLERANCE) {
+                for (int later = k + 1; later < starts; later++)
+                    cancel[later] = true;
+            }
+        }
+    };
+
+    if (pool)
+        pool->parallelFor(0, starts, body);
+    else
+        body(0, starts);
+
+    int best = -1;
+    for (int k = 0; k < starts; k++) {
+        if (!results[k].finished)
+            continue;
+
+        if (results[k].residual < MULTI_START_TOLERANCE) {
+            best = k;
+            break;
+        }
+
+        if (best < 0 || results[k].residual < results[best].residual)
+            best = k;
+    }
+
+    skel.setPose(results[best].pose);
+    return results[best].iterations;
+}
@@ -0,0 +1,34 @@
+/*
+ * ikmulti.h
+ * =========
+ *
+ * multi-start solving: the same target is solved from several perturbed
+ * poses in parallel and the best result is kept
+ *
+ */
+
+#ifndef _IKMULTI_H_
+#define _IKMULTI_H_
+
+#include "ikpool.h"
+#include "ikskel.h"
+
+// number of starting poses, the largest perturbation (degrees) applied to
+// each joint angle, and the seed the perturbations are drawn from
+#define MULTI_START_COUNT 8
+#define MULTI_START_SPREAD 60.0
+#define MULTI_START_SEED 1
+
+// how close a start must get to the target to end the search
+#define MULTI_START_TOLERANCE 0.01
+
+// solves skel for target from its current pose and starts - 1 perturbed
+// poses, leaving it in the best pose found. the perturbations come from
+// seed, and the result is the lowest numbered start that reaches the
+// tolerance (or the closest start if none does), so it does not depend on
+// thread timing. returns the iterations used by the winning start
+int solveIKMultiStart(Skeleton &skel, EndTarget target, IKMethod method,
+        ThreadPool *pool, int starts = MULTI_START_COUNT,
+        unsigned seed = MULTI_START_SEED);
+
+#endif
@@ -0,0 +1,106 @@
+#include "ikpool.h"
+
+// the pool the current thread works for, if any
+static thread_local ThreadPool *workingFor = NULL;
+
+ThreadPool::ThreadPool(int threads) : running(0), stopping(false) {
+    if (threads <= 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads <= 0)
+        threads = 1;
+
+    for (int i = 0; i < threads; i++)
+        workers.push_back(std::thread(&ThreadPool::run, this));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    pending.notify_all();
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tasks.push_back(task);
+    }
+    pending.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> guard(lock);
+    idle.wait(guard, [this]() { return tasks.empty() && running == 0; });
+}
+
+void ThreadPool::parallelFor(int begin, int end, std::function<void(int, int)> body) {
+    int count = end - begin;
+    int chunks = workers.size() + 1;
+    if (chunks > count)
+        chunks = count;
+
+    // called from one of our own tasks the ranges could sit in the queue
+    // behind workers all waiting like this one, so it does them all itself
+    if (workingFor == this)
+        chunks = 1;
+
+    if (chunks <= 1) {
+        if (count > 0)
+            body(begin, end);
+        return;
+    }
+
+    // only waits on its own ranges, not on everything else in the pool
+    std::mutex doneLock;
+    std::condition_variable doneCond;
+    int remaining = chunks - 1;
+
+    for (int c = 1; c < chunks; c++) {
+        int lo = begin + count * c / chunks;
+        int hi = begin + count * (c + 1) / chunks;
+
+        submit([&, lo, hi]() {
+            body(lo, hi);
+
+            std::lock_guard<std::mutex> guard(doneLock);
+            if (--remaining == 0)
+                doneCond.notify_one();
+        });
+    }
+
+    body(begin, begin + count / chunks);
+
+    std::unique_lock<std::mutex> guard(doneLock);
+    doneCond.wait(guard, [&]() { return remaining == 0; });
+}
+
+void ThreadPool::run() {
+    workingFor = this;
+
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            pending.wait(guard, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return;
+
+            task = tasks.front();
+            tasks.pop_front();
+            ++running;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            --running;
+            if (tasks.empty() && running == 0)
+                idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * ikpool.h
+ * ========
+ *
+ * a fixed size pool of worker threads for running solves in the background
+ *
+ */
+
+#ifndef _IKPOOL_H_
+#define _IKPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+ public:
+    // threads <= 0 uses one thread per hardware core
+    ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    void submit(std::function<void()> task);
+
+    // blocks until every submitted task has finished
+    void wait();
+
+    // splits [begin, end) into one range per thread and runs body on each,
+    // returning once all of them are done. the calling thread takes the
+    // first range itself. called from a task on this pool it runs body on
+    // the whole range inline instead
+    void parallelFor(int begin, int end, std::function<void(int, int)> body);
+
+    int size() {
+        return workers.size();
+    }
+
+ private:
+    void run();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > tasks;
+
+    std::mutex lock;
+    std::condition_variable pending;
+    std::condition_variable idle;
+
+    int running;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * ikprecision.h
+ * =============
+ *
+ * precision policies for the fixed size solvers: the type joints are
+ * stored in and the type sums and trig are carried out in
+ *
+ */
+
+#ifndef _IKPRECISION_H_
+#define _IKPRECISION_H_
+
+enum Precision { PRECISION_FLOAT, PRECISION_DOUBLE, PRECISION_MIXED };
+
+// half the memory traffic and twice the simd lanes of double
+struct FloatPrecision {
+    typedef float Storage;
+    typedef float Accum;
+};
+
+// for rigs where accuracy matters more than speed
+struct DoublePrecision {
+    typedef double Storage;
+    typedef double Accum;
+};
+
+// float storage, double sums and trig
+struct MixedPrecision {
+    typedef float Storage;
+    typedef double Accum;
+};
+
+const char *precisionName(Precision precision);
+
+#endif
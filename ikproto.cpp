@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikproto.h"
+
+// values are always sent little endian, whatever the host
+static void put32(std::vector<char> &out, uint32_t value) {
+    for (int b = 0; b < 4; b++)
+        out.push_back((value >> (8 * b)) & 0xff);
+}
+
+static void put64(std::vector<char> &out, uint64_t value) {
+    for (int b = 0; b < 8; b++)
+        out.push_back((value >> (8 * b)) & 0xff);
+}
+
+static void putFloat(std::vector<char> &out, GLfloat value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put32(out, bits);
+}
+
+static uint32_t get32(const char *data) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+// walks a frame body, failing once a read would run past its end
+struct BodyReader {
+    const char *data;
+    size_t left;
+    bool ok = true;
+
+    BodyReader(const char *frame, size_t size) :
+        data(frame + PROTO_HEADER), left(size - PROTO_HEADER) { }
+
+    uint32_t u32() {
+        if (left < 4) {
+            ok = false;
+            return 0;
+        }
+        uint32_t value = get32(data);
+        data += 4;
+        left -= 4;
+        return value;
+    }
+
+    uint64_t u64() {
+        uint64_t low = u32();
+        return low | ((uint64_t)u32() << 32);
+    }
+
+    GLfloat f32() {
+        uint32_t bits = u32();
+        GLfloat value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+// the body size is patched in by endFrame
+static size_t beginFrame(std::vector<char> &out, uint32_t kind, uint32_t id) {
+    size_t start = out.size();
+    put32(out, 0);
+    put32(out, kind);
+    put32(out, id);
+    return start;
+}
+
+static void endFrame(std::vector<char> &out, size_t start) {
+    uint32_t body = out.size() - start - PROTO_HEADER;
+    for (int b = 0; b < 4; b++)
+        out[start + b] = (body >> (8 * b)) & 0xff;
+}
+
+void LatencyHistogram::add(uint32_t value) {
+    int index = value;
+    if (value >= 8) {
+        int exponent = 31 - __builtin_clz(value);
+        index = (exponent - 2) * 8 + ((value >> (exponent - 3)) & 7);
+    }
+
+    ++buckets[index];
+    ++count;
+    if (value > largest)
+        largest = value;
+}
+
+uint32_t LatencyHistogram::percentile(double fraction) const {
+    uint64_t rank = fraction * count;
+    uint64_t seen = 0;
+
+    for (size_t index = 0; index < buckets.size(); index++) {
+        seen += buckets[index];
+        if (seen > rank) {
+            // the bottom of the bucket
+            uint32_t value = index;
+            if (index >= 8)
+                value = (8 + index % 8) << (index / 8 - 1);
+            return std::min(value, largest);
+        }
+    }
+
+    return largest;
+}
+
+void encodeFrame(std::vector<char> &out, uint32_t kind, uint32_t id) {
+    beginFrame(out, kind, id);
+}
+
+void encodeSolve(std::vector<char> &out, const SolveRequest &request) {
+    size_t start = beginFrame(out, PROTO_SOLVE, request.id);
+    put32(out, request.rig);
+    put32(out, request.method);
+    put32(out, request.deadline);
+    put32(out, request.targets.size() / 2);
+    for (size_t t = 0; t < request.targets.size(); t++)
+        putFloat(out, request.targets[t]);
+    endFrame(out, start);
+}
+
+void encodeResults(std::vector<char> &out, const SolveResults &results) {
+    size_t start = beginFrame(out, PROTO_RESULTS, results.id);
+    put32(out, results.first);
+    put32(out, results.count);
+    put32(out, results.joints);
+
+    for (uint32_t t = 0; t < results.count; t++) {
+        put32(out, results.state[t]);
+        put32(out, results.iterations[t]);
+        putFloat(out, results.residual[t]);
+        for (uint32_t j = 0; j < results.joints; j++)
+            putFloat(out, results.angles[t * results.joints + j]);
+    }
+    endFrame(out, start);
+}
+
+void encodeStats(std::vector<char> &out, uint32_t id, const ServiceStats &stats) {
+    size_t start = beginFrame(out, PROTO_STATS_REPLY, id);
+    put64(out, stats.connections);
+    put64(out, stats.requests);
+    put64(out, stats.targets);
+    put64(out, stats.expired);
+    put64(out, stats.rejected);
+    put64(out, stats.stalls);
+    put32(out, stats.p50);
+    put32(out, stats.p90);
+    put32(out, stats.p99);
+    put32(out, stats.max);
+    endFrame(out, start);
+}
+
+void encodeError(std::vector<char> &out, uint32_t id, const std::string &message) {
+    size_t start = beginFrame(out, PROTO_ERROR, id);
+    out.insert(out.end(), message.begin(), message.end());
+    endFrame(out, start);
+}
+
+long frameSize(const char *data, size_t size) {
+    if (size < PROTO_HEADER)
+        return 0;
+
+    uint32_t body = get32(data);
+    if (body > PROTO_MAX_BODY)
+        return -1;
+
+    return (size >= PROTO_HEADER + body) ? PROTO_HEADER + body : 0;
+}
+
+void frameHeader(const char *data, uint32_t &kind, uint32_t &id) {
+    kind = get32(data + 4);
+    id = get32(data + 8);
+}
+
+bool decodeSolve(const char *frame, size_t size, SolveRequest &request) {
+    BodyReader body(frame, size);
+    request.id = get32(frame + 8);
+    request.rig = body.u32();
+    request.method = body.u32();
+    request.deadline = body.u32();
+
+    uint32_t count = body.u32();
+    if (!body.ok || count > PROTO_MAX_TARGETS || body.left != count * 8)
+        return false;
+
+    request.targets.resize(2 * count);
+    for (uint32_t t = 0; t < 2 * count; t++)
+        request.targets[t] = body.f32();
+    return true;
+}
+
+bool decodeResults(const char *frame, size_t size, SolveResults &results) {
+    BodyReader body(frame, size);
+    results.id = get32(frame + 8);
+    results.first = body.u32();
+    results.count = body.u32();
+    results.joints = body.u32();
+    if (!body.ok || body.left != (uint64_t)results.count * (12 + 4 * (uint64_t)results.joints))
+        return false;
+
+    results.state.resize(results.count);
+    results.iterations.resize(results.count);
+    results.residual.resize(results.count);
+    results.angles.resize((size_t)results.count * results.joints);
+
+    for (uint32_t t = 0; t < results.count; t++) {
+        results.state[t] = body.u32();
+        results.iterations[t] = body.u32();
+        results.residual[t] = body.f32();
+        for (uint32_t j = 0; j < results.joints; j++)
+            results.angles[t * results.joints + j] = body.f32();
+    }
+    return true;
+}
+
+bool decodeStats(const char *frame, size_t size, ServiceStats &stats) {
+    BodyReader body(frame, size);
+    stats.connections = body.u64();
+    stats.requests = body.u64();
+    stats.targets = body.u64();
+    stats.expired = body.u64();
+    stats.rejected = body.u64();
+    stats.stalls = body.u64();
+    stats.p50 = body.u32();
+    stats.p90 = body.u32();
+    stats.p99 = body.u32();
+    stats.max = body.u32();
+    return body.ok && body.left == 0;
+}
+
+bool decodeError(const char *frame, size_t size, std::string &message) {
+    message.assign(frame + PROTO_HEADER, size - PROTO_HEADER);
+    return true;
+}
+
+static bool unixAddress(const char *path, sockaddr_un &address, std::string &error) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        error = std::string("socket path too long: ") + path;
+        return false;
+    }
+
+    strcpy(address.sun_path, path);
+    return true;
+}
+
+int listenUnix(const char *path, std::string &error) {
+    sockaddr_un address;
+    if (!unixAddress(path, address, error))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = std::string("can't create a socket: ") + strerror(errno);
+        return -1;
+    }
+
+    unlink(path);
+    if (bind(fd, (sockaddr *)&address, sizeof(address)) < 0 || listen(fd, 64) < 0) {
+        error = std::string("can't listen on ") + path + ": " + strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+int connectUnix(const char *path, std::string &error) {
+    sockaddr_un address;
+    if (!unixAddress(path, address, error))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = std::string("can't create a socket: ") + strerror(errno);
+        return -1;
+    }
+
+    if (connect(fd, (sockaddr *)&address, sizeof(address)) < 0) {
+        error = std::string("can't connect to ") + path + ": " + strerror(errno);
+        close(fd);
+        return -1;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
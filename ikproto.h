@@ -0,0 +1,129 @@
+/*
+ * ikproto.h
+ * =========
+ *
+ * the binary protocol iksolverd speaks over a unix domain socket. every
+ * frame is a little endian header (body size, kind, request id) and a
+ * body. a client may send many solve requests without waiting for the
+ * answers, each one a rig of the daemon's library, a method, a deadline
+ * and a batch of targets. the results come back as they are solved, in
+ * frames of up to PROTO_CHUNK targets, possibly out of order: each frame
+ * says which targets it covers
+ *
+ */
+
+#ifndef _IKPROTO_H_
+#define _IKPROTO_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "ikskel.h"
+
+#define PROTO_SOCKET "/tmp/iksolverd.sock"
+
+// body size, kind and request id
+#define PROTO_HEADER 12
+
+// largest body either side accepts, and most targets in one request
+#define PROTO_MAX_BODY (16 << 20)
+#define PROTO_MAX_TARGETS 65536
+
+// targets solved per task, and so per result frame
+#define PROTO_CHUNK 256
+
+// frame kinds, client to daemon
+#define PROTO_SOLVE 1
+#define PROTO_STATS 2
+
+// daemon to client
+#define PROTO_RESULTS 3
+#define PROTO_STATS_REPLY 4
+#define PROTO_ERROR 5
+
+// state of each target in a result frame
+#define PROTO_SOLVED 0
+#define PROTO_EXPIRED 1
+
+struct SolveRequest {
+    uint32_t id;
+    uint32_t rig;
+    uint32_t method;
+
+    // microseconds after the daemon reads the request, 0 for no deadline.
+    // targets not started by then are answered PROTO_EXPIRED
+    uint32_t deadline;
+
+    // x, y pairs
+    std::vector<GLfloat> targets;
+};
+
+// the results of targets [first, first + count) of a request
+struct SolveResults {
+    uint32_t id;
+    uint32_t first, count;
+    uint32_t joints;
+
+    std::vector<uint8_t> state;
+    std::vector<uint32_t> iterations;
+    std::vector<GLfloat> residual;
+
+    // joints angles per target, the rest pose for expired ones
+    std::vector<GLfloat> angles;
+};
+
+// counts since the daemon started, latencies in microseconds from reading
+// a request to queueing its last results
+struct ServiceStats {
+    uint64_t connections = 0;
+    uint64_t requests = 0;
+    uint64_t targets = 0;
+    uint64_t expired = 0;
+    uint64_t rejected = 0;
+
+    // times a connection stopped being read because too many of its
+    // targets were in flight or its results weren't being collected
+    uint64_t stalls = 0;
+
+    uint32_t p50 = 0, p90 = 0, p99 = 0, max = 0;
+};
+
+// log scale histogram with eight buckets per power of two, so percentiles
+// are within 12.5% whatever the range
+struct LatencyHistogram {
+    std::vector<uint64_t> buckets;
+    uint64_t count = 0;
+    uint32_t largest = 0;
+
+    LatencyHistogram() : buckets(8 * 32, 0) { }
+
+    void add(uint32_t value);
+    uint32_t percentile(double fraction) const;
+};
+
+void encodeSolve(std::vector<char> &out, const SolveRequest &request);
+void encodeResults(std::vector<char> &out, const SolveResults &results);
+void encodeStats(std::vector<char> &out, uint32_t id, const ServiceStats &stats);
+void encodeError(std::vector<char> &out, uint32_t id, const std::string &message);
+
+// encodes a frame with an empty body
+void encodeFrame(std::vector<char> &out, uint32_t kind, uint32_t id);
+
+// returns the size of the frame at the start of data once all of it is
+// there, 0 if more is needed and -1 if its body is too large
+long frameSize(const char *data, size_t size);
+void frameHeader(const char *data, uint32_t &kind, uint32_t &id);
+
+// each takes a whole frame, returns false if its body is malformed
+bool decodeSolve(const char *frame, size_t size, SolveRequest &request);
+bool decodeResults(const char *frame, size_t size, SolveResults &results);
+bool decodeStats(const char *frame, size_t size, ServiceStats &stats);
+bool decodeError(const char *frame, size_t size, std::string &message);
+
+// non blocking sockets, -1 with error set on failure. listening replaces
+// a socket file left behind at path
+int listenUnix(const char *path, std::string &error);
+int connectUnix(const char *path, std::string &error);
+
+#endif
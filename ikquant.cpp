@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikquant.h"
+#include "ikskel.h"
+
+PoseQuantizer::PoseQuantizer() : count(0) { }
+
+PoseQuantizer::PoseQuantizer(int count, GLfloat maxError) : count(count), base(count), step(count),
+        level(count), wraps(count) {
+    for (int j = 0; j < count; j++)
+        setJoint(j, -180.f, 180.f, maxError);
+}
+
+PoseQuantizer::PoseQuantizer(int count, const GLfloat *minAngle, const GLfloat *maxAngle, GLfloat maxError) :
+        count(count), base(count), step(count), level(count), wraps(count) {
+    for (int j = 0; j < count; j++)
+        setJoint(j, minAngle[j], std::max(minAngle[j], maxAngle[j]), maxError);
+}
+
+void PoseQuantizer::setJoint(int joint, GLfloat lower, GLfloat upper, GLfloat maxError) {
+    double range = upper - lower;
+    base[joint] = lower;
+
+    // around the whole circle the last level is one step short of the
+    // first, otherwise both ends of the range get one. the circle starts
+    // at -180 so decoded angles stay in the range clamp() keeps
+    if (range >= 360.0) {
+        wraps[joint] = true;
+        base[joint] = -180.f;
+        range = 360.0;
+    } else {
+        wraps[joint] = false;
+    }
+
+    // the rounding of the decode comes out of the bound first
+    double levels = QUANT_LEVELS;
+    if (maxError > QUANT_ROUNDING)
+        levels = std::min(levels, ceil(range / (2.0 * (maxError - QUANT_ROUNDING))) + (wraps[joint] ? 0 : 1));
+
+    // a single level sits in the middle of the range
+    if (range <= 0.0 || levels < 2) {
+        level[joint] = 1;
+        step[joint] = range;
+        if (!wraps[joint])
+            base[joint] += 0.5 * range;
+        return;
+    }
+
+    level[joint] = levels;
+    step[joint] = range / (wraps[joint] ? levels : levels - 1);
+}
+
+GLfloat PoseQuantizer::maxError() const {
+    GLfloat worst = 0.f;
+    for (int j = 0; j < count; j++)
+        worst = std::max(worst, error(j));
+    return worst;
+}
+
+void PoseQuantizer::encode(const GLfloat *angles, uint16_t *codes) const {
+    for (int j = 0; j < count; j++) {
+        if (level[j] == 1) {
+            codes[j] = 0;
+            continue;
+        }
+
+        double offset = (double)angles[j] - base[j];
+        if (wraps[j]) {
+            long code = lround(offset / step[j]) % (long)level[j];
+            codes[j] = code < 0 ? code + level[j] : code;
+        } else {
+            double code = std::min(std::max(offset / step[j], 0.0), (double)level[j] - 1);
+            codes[j] = lround(code);
+        }
+    }
+}
+
+void PoseQuantizer::encode(const Skeleton &skel, uint16_t *codes) const {
+    std::vector<GLfloat> angles(count, 0.f);
+
+    int j = 0;
+    std::list<Joint>::const_iterator joint;
+    for (joint = skel.joints.begin(); joint != skel.joints.end() && j < count; ++joint)
+        angles[j++] = joint->angle;
+
+    encode(angles.data(), codes);
+}
+
+void PoseQuantizer::decode(const uint16_t *codes, GLfloat *angles) const {
+    int j = 0;
+
+#ifdef __SSE2__
+    // eight codes widened to two vectors of four 32 bit integers, then
+    // converted and scaled
+    const __m128i zero = _mm_setzero_si128();
+    for (; j + 8 <= count; j += 8) {
+        __m128i packed = _mm_loadu_si128((const __m128i *)(codes + j));
+        __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(packed, zero));
+        __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(packed, zero));
+
+        low = _mm_add_ps(_mm_loadu_ps(&base[j]), _mm_mul_ps(low, _mm_loadu_ps(&step[j])));
+        high = _mm_add_ps(_mm_loadu_ps(&base[j + 4]), _mm_mul_ps(high, _mm_loadu_ps(&step[j + 4])));
+
+        _mm_storeu_ps(angles + j, low);
+        _mm_storeu_ps(angles + j + 4, high);
+    }
+#endif
+
+    for (; j < count; j++)
+        angles[j] = base[j] + codes[j] * step[j];
+}
+
+void PoseQuantizer::decode(const uint16_t *codes, Skeleton &skel) const {
+    std::vector<GLfloat> angles(count);
+    decode(codes, angles.data());
+
+    int j = 0;
+    std::list<Joint>::iterator joint;
+    for (joint = skel.joints.begin(); joint != skel.joints.end() && j < count; ++joint)
+        joint->angle = angles[j++];
+
+    skel.computePositions();
+}
+
+PoseTable::PoseTable(const PoseQuantizer &quantizer) : quantizer(quantizer) { }
+
+size_t PoseTable::size() const {
+    return quantizer.joints() ? codes.size() / quantizer.joints() : 0;
+}
+
+void PoseTable::append(const GLfloat *angles) {
+    codes.resize(codes.size() + quantizer.joints());
+    quantizer.encode(angles, &codes[codes.size() - quantizer.joints()]);
+}
+
+void PoseTable::append(const Skeleton &skel) {
+    codes.resize(codes.size() + quantizer.joints());
+    quantizer.encode(skel, &codes[codes.size() - quantizer.joints()]);
+}
+
+void PoseTable::decode(size_t index, GLfloat *angles) const {
+    quantizer.decode(pose(index), angles);
+}
+
+PoseTrack::PoseTrack(const PoseQuantizer &quantizer) : quantizer(quantizer), count(0),
+        last(quantizer.joints()), scratch(quantizer.joints()) { }
+
+size_t PoseTrack::bytes() const {
+    return data.size() + keyframes.size() * sizeof(size_t);
+}
+
+void PoseTrack::append(const GLfloat *angles) {
+    quantizer.encode(angles, scratch.data());
+    append(scratch.data());
+}
+
+void PoseTrack::append(const Skeleton &skel) {
+    quantizer.encode(skel, scratch.data());
+    append(scratch.data());
+}
+
+void PoseTrack::append(const uint16_t *codes) {
+    int n = quantizer.joints();
+
+    if (count % QUANT_KEYFRAME == 0) {
+        keyframes.push_back(data.size());
+        for (int j = 0; j < n; j++) {
+            data.push_back(codes[j] & 0xff);
+            data.push_back(codes[j] >> 8);
+        }
+    } else {
+        for (int j = 0; j < n; j++) {
+            // around a wrapping range the short way, so a joint crossing
+            // 180 degrees moves by a little rather than almost a circle
+            int32_t levels = quantizer.levels(j);
+            int32_t delta = (int32_t)codes[j] - last[j];
+            if (delta > levels / 2)
+                delta -= levels;
+            else if (delta < -(levels / 2))
+                delta += levels;
+
+            uint32_t value = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+            while (value >= 0x80) {
+                data.push_back((value & 0x7f) | 0x80);
+                value >>= 7;
+            }
+            data.push_back(value);
+        }
+    }
+
+    std::copy(codes, codes + n, last.begin());
+    ++count;
+}
+
+bool PoseTrack::decode(size_t index, GLfloat *angles) const {
+    Cursor cursor = seek(index);
+    return cursor.next(angles);
+}
+
+PoseTrack::Cursor PoseTrack::seek(size_t index) const {
+    Cursor cursor;
+    cursor.track = this;
+    cursor.codes.resize(quantizer.joints());
+
+    index = std::min(index, count);
+    cursor.index = index / QUANT_KEYFRAME * QUANT_KEYFRAME;
+    cursor.offset = cursor.index < count ? keyframes[index / QUANT_KEYFRAME] : data.size();
+
+    // the poses since the keyframe only move the codes along
+    for (; cursor.index < index; ++cursor.index)
+        cursor.step();
+
+    return cursor;
+}
+
+void PoseTrack::Cursor::step() {
+    const uint8_t *in = track->data.data();
+    int n = track->quantizer.joints();
+
+    if (index % QUANT_KEYFRAME == 0) {
+        for (int j = 0; j < n; j++)
+            codes[j] = in[offset + 2 * j] | (in[offset + 2 * j + 1] << 8);
+        offset += 2 * n;
+        return;
+    }
+
+    for (int j = 0; j < n; j++) {
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = in[offset++];
+            value |= (uint32_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+
+        int32_t levels = track->quantizer.levels(j);
+        int32_t code = codes[j] + (int32_t)((value >> 1) ^ -(value & 1));
+        if (code < 0)
+            code += levels;
+        else if (code >= levels)
+            code -= levels;
+        codes[j] = code;
+    }
+}
+
+bool PoseTrack::Cursor::next(GLfloat *angles) {
+    if (index >= track->count)
+        return false;
+
+    step();
+    track->quantizer.decode(codes.data(), angles);
+    ++index;
+    return true;
+}
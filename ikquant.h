@@ -0,0 +1,159 @@
+/*
+ * ikquant.h
+ * =========
+ *
+ * compact storage for large numbers of poses: only the joint angles are
+ * kept, each as a 16 bit code. a joint's range (the whole circle, or its
+ * limits) is split into as few levels as still decode to within the
+ * error bound asked for, at most 65536 of them. decoding turns eight
+ * codes at a time back into floats with SSE2, straight into a plain
+ * angle array like the fixed size solvers keep. poses recorded over time
+ * can also be delta coded, most of their codes then take a byte
+ *
+ */
+
+#ifndef _IKQUANT_H_
+#define _IKQUANT_H_
+
+#include <float.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "ikfixed.h"
+#include "ikskel.h"
+
+// levels a 16 bit code can tell apart
+#define QUANT_LEVELS 65536
+
+// most float rounding can add to base + code * step when decoding an
+// angle within a circle, on top of the half level
+#define QUANT_ROUNDING (720.f * FLT_EPSILON)
+
+// a delta coded track stores every QUANT_KEYFRAME'th pose whole, the
+// most poses a random access has to replay
+#define QUANT_KEYFRAME 64
+
+class PoseQuantizer {
+ public:
+    PoseQuantizer();
+
+    // count joints over the whole circle, each to within maxError
+    // degrees. a bound of 0 (or one finer than 16 bits reach) uses every
+    // level, which is within 0.0029 degrees
+    explicit PoseQuantizer(int count, GLfloat maxError = 0.f);
+
+    // joint j over [minAngle[j], maxAngle[j]], a rig's limits like the
+    // ones in a RigView. angles outside them are clamped when encoded, a
+    // range of 360 degrees or more wraps around like the whole circle
+    PoseQuantizer(int count, const GLfloat *minAngle, const GLfloat *maxAngle, GLfloat maxError = 0.f);
+
+    int joints() const { return count; }
+
+    // the levels of joint j, and the most a decoded angle of it can be
+    // off by (half a level, plus float rounding)
+    uint32_t levels(int joint) const { return level[joint]; }
+    GLfloat error(int joint) const { return 0.5f * step[joint] + QUANT_ROUNDING; }
+
+    // the largest error of any joint
+    GLfloat maxError() const;
+
+    void encode(const GLfloat *angles, uint16_t *codes) const;
+    void encode(const Skeleton &skel, uint16_t *codes) const;
+
+    // writes joints() angles
+    void decode(const uint16_t *codes, GLfloat *angles) const;
+
+    // poses skel (which has joints() joints) and updates its positions
+    void decode(const uint16_t *codes, Skeleton &skel) const;
+
+    template <int N, typename Accum>
+    void decode(const uint16_t *codes, FixedSkeleton<N, GLfloat, Accum> &skel) const {
+        decode(codes, skel.angle.data());
+        skel.computePositions();
+    }
+
+ private:
+    int count;
+
+    // decoded angle = base + code * step
+    std::vector<GLfloat> base, step;
+    std::vector<uint32_t> level;
+    std::vector<char> wraps;
+
+    void setJoint(int joint, GLfloat lower, GLfloat upper, GLfloat maxError);
+};
+
+// poses of one quantizer at two bytes a joint, any of them decoded
+// without touching the others
+struct PoseTable {
+    PoseQuantizer quantizer;
+    std::vector<uint16_t> codes;
+
+    explicit PoseTable(const PoseQuantizer &quantizer);
+
+    size_t size() const;
+    size_t bytes() const { return codes.size() * sizeof(uint16_t); }
+
+    void append(const GLfloat *angles);
+    void append(const Skeleton &skel);
+
+    const uint16_t *pose(size_t index) const { return codes.data() + index * quantizer.joints(); }
+    void decode(size_t index, GLfloat *angles) const;
+};
+
+// poses of one rig over time, delta coded: keyframes are stored whole,
+// the poses between them as the change of each code from the pose
+// before, a zigzag varint that takes a byte for moves under 64 levels
+class PoseTrack {
+ public:
+    explicit PoseTrack(const PoseQuantizer &quantizer);
+
+    PoseQuantizer quantizer;
+
+    size_t size() const { return count; }
+
+    // the encoded poses and the keyframe index
+    size_t bytes() const;
+
+    void append(const GLfloat *angles);
+    void append(const Skeleton &skel);
+
+    // decodes pose index by replaying from the keyframe before it, false
+    // if there is no such pose
+    bool decode(size_t index, GLfloat *angles) const;
+
+    // plays the track back from some pose on, one pose per call
+    class Cursor {
+     public:
+        // false once past the last pose
+        bool next(GLfloat *angles);
+
+        // the pose next() returns next
+        size_t index;
+
+     private:
+        friend class PoseTrack;
+
+        const PoseTrack *track;
+        size_t offset;
+        std::vector<uint16_t> codes;
+
+        void step();
+    };
+
+    Cursor seek(size_t index) const;
+
+ private:
+    size_t count;
+    std::vector<uint8_t> data;
+    std::vector<size_t> keyframes;
+
+    // the codes of the newest pose, what the next one is coded against
+    std::vector<uint16_t> last;
+    std::vector<uint16_t> scratch;
+
+    void append(const uint16_t *codes);
+};
+
+#endif
@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikraster.h"
+#include "ikskel.h"
+
+const GLfloat methodColors[IK_AUTO + 1][3] = {
+    { 1.f, 0.f, 0.f },      // ccd: red
+    { 0.f, 1.f, 1.f },      // jacobian transpose: cyan
+    { 1.f, 0.f, 1.f },      // jacobian pseudoinverse: purple
+    { 1.f, 0.5f, 0.f },     // fabrik: orange
+    { 0.5f, 0.5f, 0.5f },   // jacobian broyden: grey
+    { 0.f, 0.5f, 0.f },     // parallel ccd: dark green
+    { 0.8f, 0.7f, 0.f }     // auto-tuned: gold
+};
+
+static uint8_t channel(GLfloat value) {
+    return lroundf(255.f * std::min(std::max(value, 0.f), 1.f));
+}
+
+Canvas::Canvas(int width, int height) : width(width), height(height), pixels(3 * width * height) {
+    GLfloat aspect = (GLfloat)width / (GLfloat)height;
+    if (width >= height) {
+        left = -aspect;
+        right = aspect;
+        bottom = -1.f;
+        top = 1.f;
+    } else {
+        left = -1.f;
+        right = 1.f;
+        bottom = -1.f / aspect;
+        top = 1.f / aspect;
+    }
+}
+
+void Canvas::clear(GLfloat r, GLfloat g, GLfloat b) {
+    uint8_t rgb[3] = { channel(r), channel(g), channel(b) };
+    for (size_t p = 0; p < pixels.size(); p += 3)
+        memcpy(&pixels[p], rgb, 3);
+}
+
+// fills the pixels whose centers are inside a convex polygon given in
+// pixel coordinates (x right, y down)
+static void fill(Canvas &canvas, const GLfloat *xy, int count, GLfloat r, GLfloat g, GLfloat b) {
+    GLfloat x0 = INFINITY, x1 = -INFINITY, y0 = INFINITY, y1 = -INFINITY;
+    GLfloat area = 0.f;
+    for (int v = 0; v < count; v++) {
+        int w = (v + 1) % count;
+        x0 = std::min(x0, xy[2 * v]);
+        x1 = std::max(x1, xy[2 * v]);
+        y0 = std::min(y0, xy[2 * v + 1]);
+        y1 = std::max(y1, xy[2 * v + 1]);
+        area += xy[2 * v] * xy[2 * w + 1] - xy[2 * w] * xy[2 * v + 1];
+    }
+    if (area == 0.f)
+        return;
+    GLfloat sign = area > 0.f ? 1.f : -1.f;
+
+    int i0 = std::max(0, (int)floorf(x0 - 0.5f));
+    int i1 = std::min(canvas.width - 1, (int)ceilf(x1 - 0.5f));
+    int k0 = std::max(0, (int)floorf(y0 - 0.5f));
+    int k1 = std::min(canvas.height - 1, (int)ceilf(y1 - 0.5f));
+
+    uint8_t rgb[3] = { channel(r), channel(g), channel(b) };
+    for (int k = k0; k <= k1; k++) {
+        GLfloat py = k + 0.5f;
+        for (int i = i0; i <= i1; i++) {
+            GLfloat px = i + 0.5f;
+
+            bool inside = true;
+            for (int v = 0; v < count && inside; v++) {
+                int w = (v + 1) % count;
+                GLfloat edge = (xy[2 * w] - xy[2 * v]) * (py - xy[2 * v + 1]) -
+                    (xy[2 * w + 1] - xy[2 * v + 1]) * (px - xy[2 * v]);
+                inside = sign * edge >= 0.f;
+            }
+
+            if (inside)
+                memcpy(&canvas.pixels[3 * (k * canvas.width + i)], rgb, 3);
+        }
+    }
+}
+
+void Canvas::polygon(const GLfloat *xy, int count, GLfloat r, GLfloat g, GLfloat b) {
+    std::vector<GLfloat> screen(2 * count);
+    for (int v = 0; v < count; v++) {
+        screen[2 * v] = (xy[2 * v] - left) / (right - left) * width;
+        screen[2 * v + 1] = (top - xy[2 * v + 1]) / (top - bottom) * height;
+    }
+    fill(*this, screen.data(), count, r, g, b);
+}
+
+void Canvas::line(GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1, GLfloat wide,
+        GLfloat r, GLfloat g, GLfloat b) {
+    GLfloat sx0 = (x0 - left) / (right - left) * width;
+    GLfloat sy0 = (top - y0) / (top - bottom) * height;
+    GLfloat sx1 = (x1 - left) / (right - left) * width;
+    GLfloat sy1 = (top - y1) / (top - bottom) * height;
+
+    GLfloat dx = sx1 - sx0;
+    GLfloat dy = sy1 - sy0;
+    GLfloat length = sqrtf(dx * dx + dy * dy);
+    if (length == 0.f)
+        return;
+
+    // a rectangle wide pixels across, ending square at both points
+    GLfloat nx = -dy / length * 0.5f * wide;
+    GLfloat ny = dx / length * 0.5f * wide;
+    GLfloat corners[8] = {
+        sx0 + nx, sy0 + ny,
+        sx1 + nx, sy1 + ny,
+        sx1 - nx, sy1 - ny,
+        sx0 - nx, sy0 - ny
+    };
+    fill(*this, corners, 4, r, g, b);
+}
+
+// a joint marker of radius around (x, y), its polygon turned by heading
+// like the rotated frame of drawKinematicChain() turns it
+static void disc(Canvas &canvas, GLfloat x, GLfloat y, GLfloat heading, GLfloat radius,
+        GLfloat r, GLfloat g, GLfloat b) {
+    GLfloat xy[2 * JOINT_SIDES];
+    for (int i = 0; i < JOINT_SIDES; i++) {
+        GLfloat a = heading + i * (2 * M_PI) / JOINT_SIDES;
+        xy[2 * i] = x + radius * cosf(a);
+        xy[2 * i + 1] = y + radius * sinf(a);
+    }
+    canvas.polygon(xy, JOINT_SIDES, r, g, b);
+}
+
+void drawChain(Canvas &canvas, const Skeleton &skel, const GLfloat color[3]) {
+    GLfloat x = skel.root_x;
+    GLfloat y = skel.root_y;
+    GLfloat heading = 0.f;
+    GLfloat lastJointLen = 0.f;
+
+    std::list<Joint>::const_iterator joint;
+    for (joint = skel.joints.begin(); joint != skel.joints.end(); ++joint) {
+        // translate along the last bone, then turn by this joint's angle
+        x += lastJointLen * cosf(heading);
+        y += lastJointLen * sinf(heading);
+        heading += joint->angle * M_PI / 180.f;
+
+        canvas.line(x, y, x + joint->length * cosf(heading), y + joint->length * sinf(heading),
+                BONE_WIDTH, color[0], color[1], color[2]);
+        disc(canvas, x, y, heading, JOINT_RAD, 1.f, 1.f, 0.f);
+
+        lastJointLen = joint->length;
+    }
+
+    if (!skel.end.active)
+        return;
+
+    x += lastJointLen * cosf(heading);
+    y += lastJointLen * sinf(heading);
+
+    // square if in drawing mode, circle otherwise
+    if (!skel.frozen) {
+        GLfloat c = cosf(heading), s = sinf(heading);
+        GLfloat corners[4][2] = {
+            { -END_SZE_X, -END_SZE_Y }, { END_SZE_X, -END_SZE_Y },
+            { END_SZE_X, END_SZE_Y }, { -END_SZE_X, END_SZE_Y }
+        };
+
+        GLfloat xy[8];
+        for (int v = 0; v < 4; v++) {
+            xy[2 * v] = x + c * corners[v][0] - s * corners[v][1];
+            xy[2 * v + 1] = y + s * corners[v][0] + c * corners[v][1];
+        }
+        canvas.polygon(xy, 4, 0.f, 0.f, 1.f);
+    } else {
+        disc(canvas, x, y, heading, JOINT_RAD, 0.f, 0.f, 1.f);
+    }
+}
+
+void drawTarget(Canvas &canvas, EndTarget target) {
+    if (!target.active)
+        return;
+
+    GLfloat pi23 = 2.f * M_PI / 3.f;
+    GLfloat pi43 = 2.f * pi23;
+    GLfloat rad = TARGET_RAD;
+
+    GLfloat xy[6] = {
+        -rad * sinf(pi43) + target.x, rad * cosf(pi43) + target.y,
+        -rad * sinf(pi23) + target.x, rad * cosf(pi23) + target.y,
+        target.x, rad + target.y
+    };
+    canvas.polygon(xy, 3, 0.f, 1.f, 0.f);
+}
+
+bool writePPM(const char *path, const Canvas &canvas) {
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    fprintf(file, "P6\n%d %d\n255\n", canvas.width, canvas.height);
+    bool ok = fwrite(canvas.pixels.data(), 1, canvas.pixels.size(), file) == canvas.pixels.size();
+    return fclose(file) == 0 && ok;
+}
+
+static void putBig32(std::vector<uint8_t> &out, uint32_t value) {
+    for (int b = 3; b >= 0; b--)
+        out.push_back((value >> (8 * b)) & 0xff);
+}
+
+struct CrcTable {
+    uint32_t entry[256];
+
+    CrcTable() {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            entry[n] = c;
+        }
+    }
+};
+
+static uint32_t crc32(const uint8_t *data, size_t size) {
+    // built once, by whichever thread writes the first image
+    static const CrcTable table;
+
+    uint32_t c = 0xffffffffu;
+    for (size_t i = 0; i < size; i++)
+        c = table.entry[(c ^ data[i]) & 0xff] ^ (c >> 8);
+    return c ^ 0xffffffffu;
+}
+
+static void putChunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data) {
+    putBig32(out, data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBig32(out, crc32(&out[start], out.size() - start));
+}
+
+// deflate bits go out least significant first, huffman codes most
+// significant first
+struct BitWriter {
+    std::vector<uint8_t> &out;
+    uint32_t bits = 0;
+    int count = 0;
+
+    BitWriter(std::vector<uint8_t> &out) : out(out) { }
+
+    void put(uint32_t value, int n) {
+        bits |= value << count;
+        count += n;
+        while (count >= 8) {
+            out.push_back(bits & 0xff);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    void code(uint32_t value, int n) {
+        uint32_t reversed = 0;
+        for (int b = 0; b < n; b++)
+            reversed |= ((value >> b) & 1) << (n - 1 - b);
+        put(reversed, n);
+    }
+
+    void flush() {
+        if (count > 0)
+            out.push_back(bits & 0xff);
+        bits = 0;
+        count = 0;
+    }
+};
+
+static const int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const int lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const int distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const int distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// a symbol of the fixed literal/length code
+static void putSymbol(BitWriter &writer, int symbol) {
+    if (symbol < 144)
+        writer.code(0x30 + symbol, 8);
+    else if (symbol < 256)
+        writer.code(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        writer.code(symbol - 256, 7);
+    else
+        writer.code(0xc0 + symbol - 280, 8);
+}
+
+static void putMatch(BitWriter &writer, int length, int distance) {
+    int l = 28;
+    while (lengthBase[l] > length)
+        --l;
+    putSymbol(writer, 257 + l);
+    writer.put(length - lengthBase[l], lengthExtra[l]);
+
+    int d = 29;
+    while (distanceBase[d] > distance)
+        --d;
+    writer.code(d, 5);
+    writer.put(distance - distanceBase[d], distanceExtra[d]);
+}
+
+// one block with the fixed huffman codes, matching only against the
+// pixel to the left and the row above
+static void deflate(const std::vector<uint8_t> &data, size_t stride, std::vector<uint8_t> &out) {
+    BitWriter writer(out);
+    writer.put(1, 1);
+    writer.put(1, 2);
+
+    size_t distances[2] = { 3, stride };
+    size_t p = 0;
+    while (p < data.size()) {
+        size_t bestLength = 0, bestDistance = 0;
+        for (size_t distance : distances) {
+            if (distance > p || distance > 32768)
+                continue;
+
+            size_t length = 0;
+            size_t limit = std::min((size_t)258, data.size() - p);
+            while (length < limit && data[p + length] == data[p + length - distance])
+                ++length;
+
+            if (length > bestLength) {
+                bestLength = length;
+                bestDistance = distance;
+            }
+        }
+
+        if (bestLength >= 3) {
+            putMatch(writer, bestLength, bestDistance);
+            p += bestLength;
+        } else {
+            putSymbol(writer, data[p++]);
+        }
+    }
+
+    putSymbol(writer, 256);
+    writer.flush();
+}
+
+bool writePNG(const char *path, const Canvas &canvas) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    // every row starts with filter type 0, the pixels as they are
+    size_t stride = 3 * canvas.width + 1;
+    std::vector<uint8_t> raw(stride * canvas.height);
+    for (int k = 0; k < canvas.height; k++) {
+        raw[k * stride] = 0;
+        memcpy(&raw[k * stride + 1], &canvas.pixels[3 * k * canvas.width], 3 * canvas.width);
+    }
+
+    std::vector<uint8_t> header;
+    putBig32(header, canvas.width);
+    putBig32(header, canvas.height);
+    header.push_back(8);
+    header.push_back(2);
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+
+    // a zlib stream: header, deflate data, adler-32 of the raw bytes
+    std::vector<uint8_t> image = { 0x78, 0x01 };
+    deflate(raw, stride, image);
+
+    // the sums can go 5552 bytes before they have to be reduced
+    uint32_t a = 1, b = 0;
+    for (size_t start = 0; start < raw.size(); start += 5552) {
+        size_t end = std::min(raw.size(), start + 5552);
+        for (size_t i = start; i < end; i++) {
+            a += raw[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    putBig32(image, (b << 16) | a);
+
+    std::vector<uint8_t> out(signature, signature + 8);
+    putChunk(out, "IHDR", header);
+    putChunk(out, "IDAT", image);
+    putChunk(out, "IEND", std::vector<uint8_t>());
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return false;
+
+    bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,73 @@
+/*
+ * ikraster.h
+ * ==========
+ *
+ * drawing skeletons without OpenGL: chains, their joints and end
+ * effectors, and the target are filled into an RGB image in memory the
+ * way display() draws them in the window, with the same sizes, colors and
+ * view of the world. images are written as binary PPM or as PNG, whose
+ * deflate stream only codes repeats of the pixel to the left or the row
+ * above, which is most of a frame
+ *
+ */
+
+#ifndef _IKRASTER_H_
+#define _IKRASTER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "ikskel.h"
+
+// size of the displayed end effector
+#define END_SZE_X 0.025
+#define END_SZE_Y 0.025
+
+// width of the bone, in pixels like glLineWidth()
+#define BONE_WIDTH 5
+
+// radius of the joint markers
+#define JOINT_RAD 0.03
+
+// radius of the target marker
+#define TARGET_RAD 0.025
+
+// sides of the polygons joint markers are drawn as
+#define JOINT_SIDES 20
+
+// the color each method's skeleton is drawn with
+extern const GLfloat methodColors[IK_AUTO + 1][3];
+
+struct Canvas {
+    int width, height;
+
+    // rows top to bottom, three bytes a pixel
+    std::vector<uint8_t> pixels;
+
+    // the part of the world in view, as reshape() sets it up for a window
+    // of this size
+    GLfloat left, right, bottom, top;
+
+    Canvas(int width, int height);
+
+    void clear(GLfloat r, GLfloat g, GLfloat b);
+
+    // fills a convex polygon of count (x, y) world space vertices
+    void polygon(const GLfloat *xy, int count, GLfloat r, GLfloat g, GLfloat b);
+
+    // a line pixels wide
+    void line(GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1, GLfloat pixels,
+            GLfloat r, GLfloat g, GLfloat b);
+};
+
+// skel as drawKinematicChain() draws it, from its angles and lengths
+void drawChain(Canvas &canvas, const Skeleton &skel, const GLfloat color[3]);
+
+// the target triangle of display()
+void drawTarget(Canvas &canvas, EndTarget target);
+
+// false if path can't be written
+bool writePPM(const char *path, const Canvas &canvas);
+bool writePNG(const char *path, const Canvas &canvas);
+
+#endif
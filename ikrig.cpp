@@ -0,0 +1,186 @@
+/*
+ * ikrig.cpp
+ * =========
+ *
+ * converts skeleton libraries between text and the binary format, and
+ * validates binary ones
+ *
+ *   ikrig convert <rigs.txt> <rigs.iklb>
+ *   ikrig dump <rigs.iklb>
+ *   ikrig validate <rigs.iklb>
+ *   ikrig random <rigs> <joints> <rigs.iklb> [seed]
+ *
+ * the text format has one rig per "rig" line followed by its joints,
+ * blank lines and lines starting with # are skipped:
+ *
+ *   rig <root x> <root y>
+ *   joint <length> <rest angle> [<min angle> <max angle>]
+ *
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "iklib.h"
+#include "ikskel.h"
+
+static int usage() {
+    std::cerr << "usage: ikrig convert <rigs.txt> <rigs.iklb>" << std::endl <<
+        "       ikrig dump <rigs.iklb>" << std::endl <<
+        "       ikrig validate <rigs.iklb>" << std::endl <<
+        "       ikrig random <rigs> <joints> <rigs.iklb> [seed]" << std::endl;
+    return 2;
+}
+
+static int convert(const char *in, const char *out) {
+    std::ifstream file(in);
+    if (!file) {
+        std::cerr << "can't open " << in << std::endl;
+        return 1;
+    }
+
+    std::vector<RigDescription> rigs;
+    std::string line;
+    int number = 0;
+
+    while (std::getline(file, line)) {
+        ++number;
+
+        std::istringstream fields(line);
+        std::string kind;
+        if (!(fields >> kind) || kind[0] == '#')
+            continue;
+
+        if (kind == "rig") {
+            rigs.push_back(RigDescription());
+            if (!(fields >> rigs.back().root_x >> rigs.back().root_y)) {
+                std::cerr << in << ":" << number << ": expected rig <root x> <root y>" << std::endl;
+                return 1;
+            }
+        } else if (kind == "joint" && !rigs.empty()) {
+            GLfloat length, angle, lower = -180.f, upper = 180.f;
+            if (!(fields >> length >> angle)) {
+                std::cerr << in << ":" << number << ": expected joint <length> <angle>" << std::endl;
+                return 1;
+            }
+
+            // the limits come as a pair or not at all
+            if (fields >> lower && !(fields >> upper)) {
+                std::cerr << in << ":" << number << ": a min angle needs a max angle" << std::endl;
+                return 1;
+            }
+
+            rigs.back().addJoint(length, angle, lower, upper);
+        } else {
+            std::cerr << in << ":" << number << ": unexpected \"" << kind << "\"" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!writeSkeletonLibrary(out, rigs)) {
+        std::cerr << "can't write " << out << std::endl;
+        return 1;
+    }
+
+    std::cout << "wrote " << rigs.size() << " rigs to " << out << std::endl;
+    return 0;
+}
+
+static int dump(const char *path) {
+    SkeletonLibrary library;
+    std::string error;
+    if (!library.open(path, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    // enough digits for a float to read back exactly
+    std::cout.precision(9);
+
+    for (int r = 0; r < library.size(); r++) {
+        RigView view;
+        if (!library.rig(r, view)) {
+            std::cerr << "rig " << r << " is damaged, run ikrig validate" << std::endl;
+            return 1;
+        }
+
+        std::cout << "rig " << view.root_x << " " << view.root_y << std::endl;
+        for (int j = 0; j < view.count; j++) {
+            std::cout << "joint " << view.length[j] << " " << view.angle[j] << " " <<
+                view.minAngle[j] << " " << view.maxAngle[j] << std::endl;
+        }
+    }
+
+    return 0;
+}
+
+static int validate(const char *path) {
+    SkeletonLibrary library;
+    std::string error;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    bool opened = library.open(path, error);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    if (!opened) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> errors;
+    int problems = library.validate(errors);
+    for (size_t e = 0; e < errors.size(); e++)
+        std::cerr << path << ": " << errors[e] << std::endl;
+
+    std::cout << path << ": " << library.size() << " rigs, opened in " << 1e6 * elapsed <<
+        " us, " << problems << " problems" << std::endl;
+    return problems ? 1 : 0;
+}
+
+// a library of random chains, for load testing
+static int generate(int count, int joints, const char *out, unsigned seed) {
+    if (count < 0 || joints <= 0)
+        return usage();
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<GLfloat> angle(-30.f, 30.f);
+    std::uniform_real_distribution<GLfloat> length(0.5f, 1.5f);
+
+    std::vector<RigDescription> rigs(count);
+    for (int r = 0; r < count; r++) {
+        for (int j = 0; j < joints; j++)
+            rigs[r].addJoint(length(rng) * 0.8f / joints, angle(rng), -90.f, 90.f);
+    }
+
+    if (!writeSkeletonLibrary(out, rigs)) {
+        std::cerr << "can't write " << out << std::endl;
+        return 1;
+    }
+
+    std::cout << "wrote " << count << " rigs to " << out << std::endl;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 4 && strcmp(argv[1], "convert") == 0)
+        return convert(argv[2], argv[3]);
+    if (argc == 3 && strcmp(argv[1], "dump") == 0)
+        return dump(argv[2]);
+    if (argc == 3 && strcmp(argv[1], "validate") == 0)
+        return validate(argv[2]);
+    if ((argc == 5 || argc == 6) && strcmp(argv[1], "random") == 0)
+        return generate(atoi(argv[2]), atoi(argv[3]), argv[4], argc == 6 ? atoi(argv[5]) : 1);
+
+    return usage();
+}
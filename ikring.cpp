@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikring.h"
+#include "ikskel.h"
+
+static uint64_t alignUp(uint64_t offset) {
+    return (offset + RING_ALIGN - 1) / RING_ALIGN * RING_ALIGN;
+}
+
+void RingFrame::store(const Skeleton &skel, EndTarget target) {
+    root_x = skel.root_x;
+    root_y = skel.root_y;
+    end_x = skel.end.x;
+    end_y = skel.end.y;
+    residual = sqrtf((target.x - end_x) * (target.x - end_x) + (target.y - end_y) * (target.y - end_y));
+
+    GLfloat *angles = angle();
+    GLfloat *xs = x();
+    GLfloat *ys = y();
+
+    count = 0;
+    std::list<Joint>::const_iterator joint;
+    for (joint = skel.joints.begin(); joint != skel.joints.end() && count < maxJoints; ++joint) {
+        angles[count] = joint->angle;
+        xs[count] = joint->x;
+        ys[count] = joint->y;
+        ++count;
+    }
+}
+
+PoseRing::PoseRing() : frames(0), data(NULL), bytes(0), header(NULL), current(NULL) { }
+
+PoseRing::~PoseRing() {
+    close();
+}
+
+bool PoseRing::create(const char *segment, int slots, int maxJoints, std::string &error) {
+    close();
+
+    if (slots <= 0 || maxJoints <= 0) {
+        error = "a ring needs at least one slot of at least one joint";
+        return false;
+    }
+
+    uint64_t slotSize = alignUp(sizeof(RingFrame) + 3 * sizeof(GLfloat) * (uint64_t)maxJoints);
+    uint64_t size = alignUp(sizeof(RingHeader)) + slots * slotSize;
+
+    // a stale segment might still be mapped by readers of an older ring,
+    // so it is replaced rather than reused
+    shm_unlink(segment);
+    int fd = shm_open(segment, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        error = std::string("can't create ") + segment + ": " + strerror(errno);
+        return false;
+    }
+
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, size) == 0)
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (map == MAP_FAILED) {
+        error = std::string("can't map ") + segment + ": " + strerror(errno);
+        shm_unlink(segment);
+        return false;
+    }
+
+    name = segment;
+    data = (char *)map;
+    bytes = size;
+    frames = 0;
+
+    // the segment starts out zeroed, so every slot's sequence is 0 and no
+    // frame reads as valid until it has been published
+    header = (RingHeader *)data;
+    header->version = RING_VERSION;
+    header->slots = slots;
+    header->maxJoints = maxJoints;
+    header->slotSize = slotSize;
+    header->head.store(0, std::memory_order_relaxed);
+
+    for (int s = 0; s < slots; s++)
+        slot(s)->maxJoints = maxJoints;
+
+    // readers check the magic last, once everything else is in place
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, RING_MAGIC, 4);
+    return true;
+}
+
+void PoseRing::close() {
+    if (!data)
+        return;
+
+    munmap(data, bytes);
+    shm_unlink(name.c_str());
+
+    data = NULL;
+    bytes = 0;
+    header = NULL;
+    current = NULL;
+}
+
+RingFrame *PoseRing::slot(uint64_t frame) {
+    return (RingFrame *)(data + alignUp(sizeof(RingHeader)) + (frame % header->slots) * header->slotSize);
+}
+
+RingFrame *PoseRing::claim() {
+    if (!header)
+        return NULL;
+
+    // readers that see the odd number, or see it change while they read,
+    // know the slot is no longer the frame they wanted
+    uint64_t frame = frames + 1;
+    current = slot(frame);
+    current->sequence.store(2 * frame - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return current;
+}
+
+void PoseRing::publish() {
+    if (!current)
+        return;
+
+    ++frames;
+    current->sequence.store(2 * frames, std::memory_order_release);
+    header->head.store(frames, std::memory_order_release);
+    current = NULL;
+}
+
+bool PoseRing::publish(uint32_t skeleton, uint64_t timestamp, const Skeleton &skel, EndTarget target) {
+    if (!header || skel.joints.size() > header->maxJoints)
+        return false;
+
+    RingFrame *frame = claim();
+    frame->skeleton = skeleton;
+    frame->timestamp = timestamp;
+    frame->store(skel, target);
+    publish();
+    return true;
+}
+
+RingReader::RingReader() : cursor(0), missed(0), data(NULL), bytes(0), header(NULL) { }
+
+RingReader::~RingReader() {
+    close();
+}
+
+bool RingReader::open(const char *segment, std::string &error) {
+    close();
+
+    int fd = shm_open(segment, O_RDONLY, 0);
+    if (fd < 0) {
+        error = std::string("can't open ") + segment + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(RingHeader)) {
+        error = std::string(segment) + " is too small to be a pose ring";
+        ::close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        error = std::string("can't map ") + segment + ": " + strerror(errno);
+        return false;
+    }
+
+    data = (const char *)map;
+    bytes = info.st_size;
+    header = (const RingHeader *)data;
+
+    bool ready = memcmp(header->magic, RING_MAGIC, 4) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (!ready) {
+        error = std::string(segment) + " is not a pose ring, or isn't set up yet";
+    } else if (header->version != RING_VERSION) {
+        error = std::string(segment) + " is a version " + std::to_string(header->version) + " pose ring";
+    } else if (header->slots == 0 || header->slotSize < sizeof(RingFrame) + 3 * sizeof(GLfloat) *
+            (uint64_t)header->maxJoints || alignUp(sizeof(RingHeader)) + header->slots *
+            header->slotSize > bytes) {
+        error = std::string(segment) + " has a damaged header";
+    } else {
+        cursor = head();
+        missed = 0;
+        return true;
+    }
+
+    close();
+    return false;
+}
+
+void RingReader::close() {
+    if (data)
+        munmap((void *)data, bytes);
+
+    data = NULL;
+    bytes = 0;
+    header = NULL;
+}
+
+uint64_t RingReader::head() const {
+    return header ? header->head.load(std::memory_order_acquire) : 0;
+}
+
+const RingFrame *RingReader::slot(uint64_t frame) const {
+    return (const RingFrame *)(data + alignUp(sizeof(RingHeader)) + (frame % header->slots) * header->slotSize);
+}
+
+const RingFrame *RingReader::view(uint64_t frame) const {
+    if (!header || frame == 0)
+        return NULL;
+
+    const RingFrame *found = slot(frame);
+    if (found->sequence.load(std::memory_order_acquire) != 2 * frame)
+        return NULL;
+    return found;
+}
+
+bool RingReader::valid(uint64_t frame) const {
+    // orders the reads of the slot before the second look at its sequence
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot(frame)->sequence.load(std::memory_order_relaxed) == 2 * frame;
+}
+
+bool RingReader::read(uint64_t frame, RingPose &pose) const {
+    const RingFrame *found = view(frame);
+    if (!found)
+        return false;
+
+    // a count torn by the producer could point past the slot
+    uint32_t count = std::min(found->count, header->maxJoints);
+
+    pose.frame = frame;
+    pose.skeleton = found->skeleton;
+    pose.timestamp = found->timestamp;
+    pose.root_x = found->root_x;
+    pose.root_y = found->root_y;
+    pose.end_x = found->end_x;
+    pose.end_y = found->end_y;
+    pose.residual = found->residual;
+
+    const GLfloat *angles = (const GLfloat *)(found + 1);
+    pose.angle.assign(angles, angles + count);
+    pose.x.assign(angles + header->maxJoints, angles + header->maxJoints + count);
+    pose.y.assign(angles + 2 * header->maxJoints, angles + 2 * header->maxJoints + count);
+
+    return valid(frame);
+}
+
+bool RingReader::next(RingPose &pose) {
+    for (;;) {
+        uint64_t newest = head();
+        if (cursor >= newest)
+            return false;
+
+        // frames more than a ring behind the newest are gone already
+        uint64_t frame = cursor + 1;
+        if (newest - frame >= header->slots) {
+            missed += newest - header->slots + 1 - frame;
+            frame = newest - header->slots + 1;
+        }
+
+        if (read(frame, pose)) {
+            cursor = frame;
+            return true;
+        }
+
+        // overwritten while it was copied, the producer is a whole ring
+        // ahead, so skip it and go again from the new head
+        ++missed;
+        cursor = frame;
+    }
+}
+
+bool RingReader::latest(RingPose &pose) {
+    for (;;) {
+        uint64_t newest = head();
+        if (cursor >= newest)
+            return false;
+
+        if (read(newest, pose)) {
+            cursor = newest;
+            return true;
+        }
+    }
+}
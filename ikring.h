@@ -0,0 +1,164 @@
+/*
+ * ikring.h
+ * ========
+ *
+ * publishing solved poses to other processes through shared memory: one
+ * producer writes frames in place into a ring of fixed size slots in a
+ * shm_open() segment, any number of consumers map it read only. each slot
+ * is guarded by a sequence number (a seqlock): odd while the producer is
+ * writing it, twice the frame number once the frame is readable. readers
+ * take no locks and make no system calls, they check the sequence number
+ * before and after looking at a slot and retry or skip ahead if the
+ * producer got there in the meantime. the producer never waits for them
+ *
+ */
+
+#ifndef _IKRING_H_
+#define _IKRING_H_
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "ikskel.h"
+
+#define RING_MAGIC "IKRB"
+#define RING_VERSION 1
+
+// name of the segment main publishes to
+#define RING_NAME "/iksolver-poses"
+
+// slots and header fields start on their own cache lines
+#define RING_ALIGN 64
+
+struct RingHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t slots;
+    uint32_t maxJoints;
+    uint64_t slotSize;
+
+    // number of the newest readable frame, 0 before the first, on its own
+    // line so publishing doesn't touch the one the fields above are on
+    alignas(RING_ALIGN) std::atomic<uint64_t> head;
+};
+
+// the start of a slot, followed by its joints laid out like the fixed
+// size solvers keep them: angle[maxJoints], x[maxJoints], y[maxJoints]
+struct RingFrame {
+    std::atomic<uint64_t> sequence;
+
+    uint32_t skeleton;
+    uint32_t count;
+    uint64_t timestamp;
+    GLfloat root_x, root_y;
+    GLfloat end_x, end_y;
+    GLfloat residual;
+    uint32_t maxJoints;
+
+    GLfloat *angle() { return (GLfloat *)(this + 1); }
+    GLfloat *x() { return angle() + maxJoints; }
+    GLfloat *y() { return x() + maxJoints; }
+    const GLfloat *angle() const { return (const GLfloat *)(this + 1); }
+    const GLfloat *x() const { return angle() + maxJoints; }
+    const GLfloat *y() const { return x() + maxJoints; }
+
+    // fills in the pose of skel, at most maxJoints joints of it
+    void store(const Skeleton &skel, EndTarget target);
+};
+
+// a frame copied out of the ring
+struct RingPose {
+    uint64_t frame;
+    uint32_t skeleton;
+    uint64_t timestamp;
+    GLfloat root_x, root_y;
+    GLfloat end_x, end_y;
+    GLfloat residual;
+    std::vector<GLfloat> angle, x, y;
+};
+
+class PoseRing {
+ public:
+    PoseRing();
+    ~PoseRing();
+
+    // creates (or replaces) the segment name with room for slots frames
+    // of up to maxJoints joints
+    bool create(const char *name, int slots, int maxJoints, std::string &error);
+
+    // unmaps and removes the segment, readers keep what they mapped
+    void close();
+
+    // the slot of the next frame, marked as being written. fill it in
+    // and hand it to publish(), nothing else may be claimed meanwhile
+    RingFrame *claim();
+    void publish();
+
+    // claim, store and publish in one. false if there is no ring or the
+    // skeleton has more joints than a slot holds
+    bool publish(uint32_t skeleton, uint64_t timestamp, const Skeleton &skel, EndTarget target);
+
+    bool isOpen() const { return header != NULL; }
+
+    // frames published so far
+    uint64_t frames;
+
+ private:
+    std::string name;
+    char *data;
+    size_t bytes;
+    RingHeader *header;
+    RingFrame *current;
+
+    RingFrame *slot(uint64_t frame);
+
+    PoseRing(const PoseRing &);
+    PoseRing &operator=(const PoseRing &);
+};
+
+class RingReader {
+ public:
+    RingReader();
+    ~RingReader();
+
+    bool open(const char *name, std::string &error);
+    void close();
+
+    // the newest readable frame, 0 if nothing has been published
+    uint64_t head() const;
+
+    // copies frame out, false if it isn't in the ring (not published
+    // yet, or already overwritten) or was overwritten while copying
+    bool read(uint64_t frame, RingPose &pose) const;
+
+    // zero copy: the slot of frame, to be looked at in place, or NULL if
+    // it doesn't hold that frame. anything read from it only counts once
+    // valid(frame) confirms the producer hasn't started overwriting it
+    const RingFrame *view(uint64_t frame) const;
+    bool valid(uint64_t frame) const;
+
+    // the frame after the last one returned, or the oldest one still in
+    // the ring if the reader fell behind by more than its size. returns
+    // false once there is nothing newer. frames skipped are added to missed
+    bool next(RingPose &pose);
+
+    // the newest frame, false if nothing new was published since the
+    // last call to latest() or next()
+    bool latest(RingPose &pose);
+
+    uint64_t cursor, missed;
+
+ private:
+    const char *data;
+    size_t bytes;
+    const RingHeader *header;
+
+    const RingFrame *slot(uint64_t frame) const;
+
+    RingReader(const RingReader &);
+    RingReader &operator=(const RingReader &);
+};
+
+#endif
@@ -0,0 +1,403 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "iksink.h"
+#include "ikskel.h"
+
+// values are always written little endian, whatever the host
+static void put8(std::vector<char> &out, uint8_t value) {
+    out.push_back(value);
+}
+
+static void put32(std::vector<char> &out, uint32_t value) {
+    for (int b = 0; b < 4; b++)
+        out.push_back((value >> (8 * b)) & 0xff);
+}
+
+static void put64(std::vector<char> &out, uint64_t value) {
+    for (int b = 0; b < 8; b++)
+        out.push_back((value >> (8 * b)) & 0xff);
+}
+
+// seven bits per byte, low bits first, high bit set on all but the last
+static void putVarint(std::vector<char> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(value);
+}
+
+static uint32_t floatBits(GLfloat value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static GLfloat bitsFloat(uint32_t bits) {
+    GLfloat value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+PoseSink::PoseSink() : records(0), dropped(0), bytes(0), fd(-1), delta(false),
+    direct(false), closing(false), failed(false), allocated(0) {
+    current.data = NULL;
+    current.used = 0;
+}
+
+PoseSink::~PoseSink() {
+    close();
+
+    for (size_t b = 0; b < spare.size(); b++)
+        free(spare[b]);
+}
+
+bool PoseSink::takeBuffer(Buffer &buffer) {
+    if (!spare.empty()) {
+        buffer.data = spare.back();
+        spare.pop_back();
+    } else {
+        // o_direct wants the memory aligned like the writes
+        void *data = NULL;
+        if (posix_memalign(&data, SINK_BLOCK, SINK_BUFFER_SIZE) != 0)
+            return false;
+        buffer.data = (char *)data;
+        ++allocated;
+    }
+
+    buffer.used = 0;
+    return true;
+}
+
+bool PoseSink::open(const char *path, bool deltaEncode, bool directIO, std::string &error) {
+    close();
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    direct = false;
+
+#ifdef O_DIRECT
+    if (directIO) {
+        fd = ::open(path, flags | O_DIRECT, 0644);
+        direct = fd >= 0;
+    }
+#endif
+
+    if (fd < 0)
+        fd = ::open(path, flags, 0644);
+
+    if (fd < 0) {
+        error = std::string("can't open ") + path + ": " + strerror(errno);
+        return false;
+    }
+
+    delta = deltaEncode;
+    closing = false;
+    failed = false;
+    records = dropped = 0;
+    bytes = 0;
+    previous.clear();
+
+    if (!takeBuffer(current)) {
+        error = "out of memory";
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    record.clear();
+    record.insert(record.end(), SINK_MAGIC, SINK_MAGIC + 4);
+    put32(record, SINK_VERSION);
+    put32(record, delta ? SINK_DELTA : 0);
+    append(&record[0], record.size());
+
+    writer = std::thread(&PoseSink::writeBuffers, this);
+    return true;
+}
+
+bool PoseSink::append(const char *data, size_t size) {
+    // buffers are only handed over full, so every write but the last one
+    // is a whole number of blocks
+    while (size > 0) {
+        size_t n = std::min(size, (size_t)SINK_BUFFER_SIZE - current.used);
+        memcpy(current.data + current.used, data, n);
+        current.used += n;
+        data += n;
+        size -= n;
+
+        if (current.used == SINK_BUFFER_SIZE) {
+            full.push_back(current);
+            ready.notify_one();
+
+            // the full buffer belongs to the writer now, without a
+            // replacement there is nowhere left to write
+            if (!takeBuffer(current)) {
+                current.data = NULL;
+                current.used = 0;
+                failed = true;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool PoseSink::write(const PoseSample &sample) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (fd < 0 || failed) {
+        ++dropped;
+        return false;
+    }
+
+    uint32_t count = sample.angles.size();
+    uint32_t bits[3] = { floatBits(sample.end_x), floatBits(sample.end_y), floatBits(sample.residual) };
+
+    std::map<uint32_t, Previous>::iterator last = previous.find(sample.skeleton);
+    bool relative = delta && last != previous.end() && last->second.bits.size() == count + 3 &&
+        sample.timestamp >= last->second.timestamp;
+
+    record.clear();
+    if (relative) {
+        const std::vector<uint32_t> &before = last->second.bits;
+
+        put8(record, SINK_RECORD_DELTA);
+        putVarint(record, sample.skeleton);
+        putVarint(record, sample.timestamp - last->second.timestamp);
+        for (int f = 0; f < 3; f++)
+            putVarint(record, bits[f] ^ before[f]);
+        for (uint32_t j = 0; j < count; j++)
+            putVarint(record, floatBits(sample.angles[j]) ^ before[j + 3]);
+    } else {
+        put8(record, SINK_RECORD_RAW);
+        put32(record, sample.skeleton);
+        put64(record, sample.timestamp);
+        put32(record, count);
+        for (int f = 0; f < 3; f++)
+            put32(record, bits[f]);
+        for (uint32_t j = 0; j < count; j++)
+            put32(record, floatBits(sample.angles[j]));
+    }
+
+    // every buffer this record fills up needs a replacement, if there
+    // aren't enough the writer is behind and the record is dropped
+    size_t handoffs = (current.used + record.size()) / SINK_BUFFER_SIZE;
+    if (handoffs > spare.size() + (SINK_MAX_BUFFERS - allocated)) {
+        ++dropped;
+        return false;
+    }
+
+    if (!append(&record[0], record.size())) {
+        ++dropped;
+        return false;
+    }
+    ++records;
+    bytes += record.size();
+
+    // the next delta starts from this frame
+    if (delta) {
+        Previous &frame = previous[sample.skeleton];
+        frame.timestamp = sample.timestamp;
+        frame.bits.assign(bits, bits + 3);
+        for (uint32_t j = 0; j < count; j++)
+            frame.bits.push_back(floatBits(sample.angles[j]));
+    }
+
+    return true;
+}
+
+bool PoseSink::write(uint32_t skeleton, uint64_t timestamp, Skeleton &skel, EndTarget target) {
+    PoseSample sample;
+    sample.skeleton = skeleton;
+    sample.timestamp = timestamp;
+    sample.angles = skel.getPose().angles;
+    sample.end_x = skel.end.x;
+    sample.end_y = skel.end.y;
+    sample.residual = sqrtf((target.x - skel.end.x) * (target.x - skel.end.x) +
+            (target.y - skel.end.y) * (target.y - skel.end.y));
+    return write(sample);
+}
+
+void PoseSink::writeBuffers() {
+    uint64_t total = 0;
+
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        ready.wait(guard, [this] { return !full.empty() || closing; });
+        if (full.empty())
+            break;
+
+        Buffer buffer = full.front();
+        full.pop_front();
+        guard.unlock();
+
+        // the last buffer is padded out to a block, the padding is cut
+        // off again once the writer is done
+        size_t size = buffer.used;
+        if (direct && size % SINK_BLOCK != 0) {
+            size = (size / SINK_BLOCK + 1) * SINK_BLOCK;
+            memset(buffer.data + buffer.used, 0, size - buffer.used);
+        }
+
+        size_t done = 0;
+        bool ok = true;
+        while (done < size) {
+            ssize_t n = ::write(fd, buffer.data + done, size - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            done += n;
+        }
+        total += buffer.used;
+
+        guard.lock();
+        spare.push_back(buffer.data);
+        if (!ok)
+            failed = true;
+    }
+
+    if (direct && ftruncate(fd, total) != 0)
+        failed = true;
+}
+
+void PoseSink::close() {
+    if (fd < 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (current.used > 0)
+            full.push_back(current);
+        else if (current.data)
+            spare.push_back(current.data);
+        current.data = NULL;
+        current.used = 0;
+
+        closing = true;
+        ready.notify_one();
+    }
+
+    writer.join();
+    ::close(fd);
+    fd = -1;
+}
+
+static bool get(std::ifstream &file, uint64_t &value, int size) {
+    unsigned char bytes[8];
+    if (!file.read((char *)bytes, size))
+        return false;
+
+    value = 0;
+    for (int b = 0; b < size; b++)
+        value |= (uint64_t)bytes[b] << (8 * b);
+    return true;
+}
+
+static bool getVarint(std::ifstream &file, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = file.get();
+        if (byte == EOF)
+            return false;
+
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool PoseReader::open(const char *path, std::string &error) {
+    file.open(path, std::ios::binary);
+    previous.clear();
+
+    char magic[4];
+    uint64_t version, flags;
+    if (!file.read(magic, 4) || memcmp(magic, SINK_MAGIC, 4) != 0 ||
+            !get(file, version, 4) || !get(file, flags, 4)) {
+        error = std::string(path) + " is not a pose stream";
+        return false;
+    }
+
+    if (version != SINK_VERSION) {
+        error = std::string(path) + " is a version " + std::to_string(version) + " pose stream";
+        return false;
+    }
+
+    delta = flags & SINK_DELTA;
+    return true;
+}
+
+bool PoseReader::next(PoseSample &sample) {
+    int kind = file.get();
+    uint64_t value, count;
+
+    if (kind == SINK_RECORD_RAW) {
+        if (!get(file, value, 4))
+            return false;
+        sample.skeleton = value;
+        if (!get(file, sample.timestamp, 8) || !get(file, count, 4))
+            return false;
+
+        GLfloat *fields[3] = { &sample.end_x, &sample.end_y, &sample.residual };
+        for (int f = 0; f < 3; f++) {
+            if (!get(file, value, 4))
+                return false;
+            *fields[f] = bitsFloat(value);
+        }
+
+        sample.angles.resize(count);
+        for (uint64_t j = 0; j < count; j++) {
+            if (!get(file, value, 4))
+                return false;
+            sample.angles[j] = bitsFloat(value);
+        }
+    } else if (kind == SINK_RECORD_DELTA && delta) {
+        if (!getVarint(file, value))
+            return false;
+
+        std::map<uint32_t, PoseSample>::iterator last = previous.find(value);
+        if (last == previous.end())
+            return false;
+
+        const PoseSample &before = last->second;
+        sample.skeleton = value;
+        if (!getVarint(file, value))
+            return false;
+        sample.timestamp = before.timestamp + value;
+
+        const GLfloat beforeFields[3] = { before.end_x, before.end_y, before.residual };
+        GLfloat *fields[3] = { &sample.end_x, &sample.end_y, &sample.residual };
+        for (int f = 0; f < 3; f++) {
+            if (!getVarint(file, value))
+                return false;
+            *fields[f] = bitsFloat(floatBits(beforeFields[f]) ^ value);
+        }
+
+        sample.angles.resize(before.angles.size());
+        for (size_t j = 0; j < before.angles.size(); j++) {
+            if (!getVarint(file, value))
+                return false;
+            sample.angles[j] = bitsFloat(floatBits(before.angles[j]) ^ value);
+        }
+    } else {
+        return false;
+    }
+
+    if (delta)
+        previous[sample.skeleton] = sample;
+    return true;
+}
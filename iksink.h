@@ -0,0 +1,125 @@
+/*
+ * iksink.h
+ * ========
+ *
+ * streaming solved poses out of the process: records (skeleton id,
+ * timestamp, joint angles, end effector, residual) are encoded little
+ * endian into large buffers, and full buffers are written by a background
+ * thread, so solver threads never wait on the disk. between frames of the
+ * same skeleton the floats can be delta encoded as varints of the xor of
+ * their bits, which is small when a value barely moved
+ *
+ */
+
+#ifndef _IKSINK_H_
+#define _IKSINK_H_
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ikskel.h"
+
+#define SINK_MAGIC "IKPS"
+#define SINK_VERSION 1
+
+// header flag: records may be delta encoded
+#define SINK_DELTA 1
+
+// record kinds
+#define SINK_RECORD_RAW 0
+#define SINK_RECORD_DELTA 1
+
+// size of each buffer (a multiple of SINK_BLOCK, which O_DIRECT writes
+// have to be aligned to), and how many may exist before records are
+// dropped instead of waiting for the writer
+#define SINK_BUFFER_SIZE (1 << 20)
+#define SINK_BLOCK 4096
+#define SINK_MAX_BUFFERS 16
+
+struct PoseSample {
+    uint32_t skeleton;
+    uint64_t timestamp;
+    std::vector<GLfloat> angles;
+    GLfloat end_x, end_y;
+    GLfloat residual;
+};
+
+class PoseSink {
+ public:
+    PoseSink();
+    ~PoseSink();
+
+    // starts writing to path. direct asks for O_DIRECT, quietly falling
+    // back to buffered writes where the file system refuses it
+    bool open(const char *path, bool delta, bool direct, std::string &error);
+
+    // writes what is left and waits for the writer
+    void close();
+
+    // encodes one pose into the current buffer. never blocks on the disk:
+    // if the writer is too far behind the record is dropped and false is
+    // returned. safe to call from several threads
+    bool write(const PoseSample &sample);
+    bool write(uint32_t skeleton, uint64_t timestamp, Skeleton &skel, EndTarget target);
+
+    bool isOpen() const { return fd >= 0; }
+    bool isDirect() const { return direct; }
+
+    // records accepted and dropped, and bytes encoded so far
+    long records, dropped;
+    uint64_t bytes;
+
+ private:
+    struct Buffer {
+        char *data;
+        size_t used;
+    };
+
+    struct Previous {
+        uint64_t timestamp;
+        std::vector<uint32_t> bits;
+    };
+
+    int fd;
+    bool delta, direct, closing, failed;
+
+    std::mutex lock;
+    std::condition_variable ready;
+    std::thread writer;
+
+    Buffer current;
+    std::deque<Buffer> full;
+    std::vector<char *> spare;
+    int allocated;
+
+    std::map<uint32_t, Previous> previous;
+    std::vector<char> record;
+
+    bool append(const char *data, size_t size);
+    bool takeBuffer(Buffer &buffer);
+    void writeBuffers();
+
+    PoseSink(const PoseSink &);
+    PoseSink &operator=(const PoseSink &);
+};
+
+// reads back what a PoseSink wrote
+class PoseReader {
+ public:
+    bool open(const char *path, std::string &error);
+    bool next(PoseSample &sample);
+
+ private:
+    std::ifstream file;
+    bool delta = false;
+    std::map<uint32_t, PoseSample> previous;
+};
+
+#endif
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <float.h>
+#include <functional>
 #include <iostream>
 #include <math.h>
 
@@ -7,10 +10,34 @@
 #include <GL/glut.h>
 #endif
 
+#include "ikfixed.h"
+#include "ikpool.h"
 #include "ikskel.h"
-#include "asst2/matrix.hpp"
+#include "iksvd.h"
 
-#define JT_ALPHA 0.05
+const char *methodName(IKMethod method) {
+    switch (method) {
+        case IK_CCD:            return "ccd";
+        case IK_TRANSPOSE:      return "jacobian transpose";
+        case IK_PSEUDOINVERSE:  return "jacobian pseudoinverse";
+        case IK_FABRIK:         return "fabrik";
+        case IK_BROYDEN:        return "jacobian broyden";
+        case IK_PARALLEL_CCD:   return "parallel ccd";
+        case IK_AUTO:           return "auto";
+    }
+
+    return "unknown";
+}
+
+const char *precisionName(Precision precision) {
+    switch (precision) {
+        case PRECISION_FLOAT:   return "float";
+        case PRECISION_DOUBLE:  return "double";
+        case PRECISION_MIXED:   return "mixed";
+    }
+
+    return "unknown";
+}
 
 void Skeleton::freezeSkeleton() {
     if (joints.empty())
@@ -23,11 +50,46 @@ void Skeleton::resetSkeleton() {
     frozen = false;
     end.active = false;
     joints = std::list<Joint>();
+    broyden = BroydenState();
+    autoConfig = SolverConfig();
+    autoTuned = false;
+    drift = 0.f;
+    anchors = 0;
+    anchoredJoints = 0;
+}
+
+Pose Skeleton::getPose() {
+    Pose pose;
+    pose.angles.reserve(joints.size());
+
+    std::list<Joint>::iterator joint;
+    for (joint = joints.begin(); joint != joints.end(); ++joint)
+        pose.angles.push_back(joint->angle);
+
+    pose.end_x = end.x;
+    pose.end_y = end.y;
+    return pose;
+}
+
+void Skeleton::setPose(const Pose &pose) {
+    size_t j = 0;
+    std::list<Joint>::iterator joint;
+    for (joint = joints.begin(); joint != joints.end() && j < pose.angles.size(); ++joint)
+        joint->angle = pose.angles[j++];
+
+    computePositions();
 }
 
 void Skeleton::solveIKwithCCD(EndTarget target) {
+    // the length and number of the bones from the joint on
+    GLfloat reach = 0.f;
+    int bones = 0;
+
     std::list<Joint>::reverse_iterator joint;
     for (joint = joints.rbegin(); joint != joints.rend(); ++joint) {
+        reach += joint->length;
+        ++bones;
+
         // calculate vectors from the joint to the target and the
         // end effector to the target
         GLfloat rd1 = target.x - joint->x;
@@ -43,50 +105,40 @@ void Skeleton::solveIKwithCCD(EndTarget target) {
         // update our angle
         joint->angle = clamp((ap * 180.f / M_PI) + joint->angle);
 
-        // calculate the new end effector position
-        GLfloat rendx = re1;
-        GLfloat rendy = re2;
-        end.x = rendx * cos(ap) - rendy * sin(ap);
-        end.y = rendy * cos(ap) + rendx * sin(ap);
-        end.x += joint->x;
-        end.y += joint->y;
-
-        GLfloat lastJointX = joint->x;
-        GLfloat lastJointY = joint->y;
-        GLfloat rootX = 0.f;
-        GLfloat rootY = 0.f;
-
-        // rotate the rest of the joints
-        std::list<Joint>::iterator ujoint;
-        for (ujoint = joint.base(); ujoint != joints.end(); ++ujoint) {
-            GLfloat ljx = lastJointX;
-            GLfloat ljy = lastJointY;
-
-            lastJointX = ujoint->x;
-            lastJointY = ujoint->y;
-
-            // place the joint centered at the origin translated
-            // away from the rest of the joints
-            rootX = ujoint->x - ljx + rootX;
-            rootY = ujoint->y - ljy + rootY;
-
-            // rotate the joint
-            ujoint->x = rootX * cos(ap) - rootY * sin(ap);
-            ujoint->y = rootY * cos(ap) + rootX * sin(ap);
-
-            // put it back in the correct space
-            ujoint->x += joint->x;
-            ujoint->y += joint->y;
-        }
+        rotateSuffix(--joint.base(), ap, reach, bones);
     }
+
+    boundDrift();
 }
 
-void Skeleton::solveIKwithJacobian(EndTarget target, JacobianMethod method) {
-    matrix v = matrix(2, 1);
-    matrix jacobian = matrix(2, joints.size()); 
+int Skeleton::computeTaskError(EndTarget target) {
+    // task space rows: end effector x and y, plus its orientation if the
+    // target has one
+    int m = target.oriented ? 3 : 2;
+    std::vector<double> &v = work.v;
+    v.resize(m);
 
-    v.setValue(target.x - end.x, 0, 0);
-    v.setValue(target.y - end.y, 1, 0);
+    v[0] = target.x - end.x;
+    v[1] = target.y - end.y;
+
+    if (target.oriented) {
+        GLfloat endAngle = 0.f;
+        std::list<Joint>::iterator joint;
+        for (joint = joints.begin(); joint != joints.end(); ++joint)
+            endAngle += joint->angle;
+
+        v[2] = ORIENT_WEIGHT * clamp(fmod(target.angle - endAngle, 360.f)) * M_PI / 180.f;
+    }
+
+    return m;
+}
+
+void Skeleton::buildJacobian(int m) {
+    // row major m x n, each column is (-ry, rx) for the vector r from
+    // the joint to the end effector, and 1 for the orientation
+    int n = joints.size();
+    std::vector<double> &jacobian = work.jacobian;
+    jacobian.resize(m * n);
 
     int j = 0;
     std::list<Joint>::iterator joint;
@@ -94,80 +146,759 @@ void Skeleton::solveIKwithJacobian(EndTarget target, JacobianMethod method) {
         double x = end.x - joint->x;
         double y = end.y - joint->y;
 
-        jacobian.setValue(-y, 0, j);
-        jacobian.setValue(x, 1, j);
+        jacobian[j] = -y;
+        jacobian[n + j] = x;
+        if (m > 2)
+            jacobian[2 * n + j] = ORIENT_WEIGHT;
 
         ++j;
     }
+}
 
-    matrix jtranspose = matrix(joints.size(), 2);
-    matrix dtheta = matrix(joints.size(), 1);
+void Skeleton::computeJJT(int m) {
+    int n = joints.size();
+    std::vector<double> &jacobian = work.jacobian;
+    std::vector<double> &jjt = work.jjt;
+    jjt.assign(m * m, 0.0);
 
-    jacobian.computeTranspose(&jtranspose);
+    for (int r = 0; r < m; r++)
+        for (int c = 0; c < m; c++)
+            for (int j = 0; j < n; j++)
+                jjt[r * m + c] += jacobian[r * n + j] * jacobian[c * n + j];
+}
 
-    switch (method) {
-        case TRANSPOSE:
-            jtranspose.computeMatrixMul(&v, &dtheta);
-            break;
+void Skeleton::composePseudoInverse(int m, std::vector<double> &total) {
+    // J^+ = J^T (J J^T)^+, joints x m
+    int n = joints.size();
+    std::vector<double> &jacobian = work.jacobian;
+    std::vector<double> &jjinverse = work.jjinverse;
+    total.assign(n * m, 0.0);
+
+    for (int j = 0; j < n; j++)
+        for (int c = 0; c < m; c++)
+            for (int r = 0; r < m; r++)
+                total[j * m + c] += jacobian[r * n + j] * jjinverse[r * m + c];
+}
 
-        case PSEUDOINVERSE:
-            matrix jjtranspose = matrix(2, 2);
-            jacobian.computeMatrixMul(&jtranspose, &jjtranspose);
+void Skeleton::solveIKwithJacobian(EndTarget target, JacobianMethod method, double alpha) {
+    int m = computeTaskError(target);
+    int n = joints.size();
+
+    std::vector<double> &v = work.v;
+    std::vector<double> &jacobian = work.jacobian;
+    std::vector<double> &dtheta = work.dtheta;
+    dtheta.assign(n, 0.0);
+
+    // the broyden method only rebuilds and refactorizes its pseudoinverse
+    // periodically, or once its rank-1 updates stop predicting the joint
+    // steps well. in between the last estimate is reused
+    bool rebuild = method != BROYDEN || broyden.age < 0 ||
+        broyden.age >= BROYDEN_REFRESH || broyden.dims != m ||
+        broyden.inverse.size() != (size_t)(m * n);
+
+    if (rebuild) {
+        buildJacobian(m);
+
+        switch (method) {
+            case TRANSPOSE:
+                for (int j = 0; j < n; j++)
+                    for (int r = 0; r < m; r++)
+                        dtheta[j] += jacobian[r * n + j] * v[r];
+                break;
+
+            case PSEUDOINVERSE:
+            case BROYDEN:
+                // only the small m x m product J J^T is inverted
+                computeJJT(m);
+                work.jjinverse.resize(m * m);
+                pseudoInverse(&work.jjt[0], m, m, &work.jjinverse[0], SVD_TOL, work.svd);
+
+                composePseudoInverse(m, (method == BROYDEN) ? broyden.inverse : work.pinv);
+
+                if (method == BROYDEN) {
+                    broyden.dims = m;
+                    broyden.age = 0;
+                }
+                break;
+        }
+    }
 
-            matrix jjinverse = matrix(2, 2);
-            jjtranspose.invertMatrix(&jjinverse, SVD_TOL);
+    if (method != TRANSPOSE) {
+        std::vector<double> &pinv = (method == BROYDEN) ? broyden.inverse : work.pinv;
+        for (int j = 0; j < n; j++)
+            for (int c = 0; c < m; c++)
+                dtheta[j] += pinv[j * m + c] * v[c];
+    }
 
-            matrix total = matrix(joints.size(), 2);
-            jtranspose.computeMatrixMul(&jjinverse, &total);
+    GLfloat startX = end.x;
+    GLfloat startY = end.y;
+    double turned = applyJointStep(dtheta, alpha);
 
-            total.computeMatrixMul(&v, &dtheta);
-            break;
+    if (method == BROYDEN) {
+        double moved[3] = { end.x - startX, end.y - startY, ORIENT_WEIGHT * turned };
+        broyden.update(dtheta, moved, alpha);
     }
+}
 
+double Skeleton::applyJointStep(std::vector<double> &dtheta, double alpha) {
+    if (activeSetSize > 0)
+        selectActiveJoints(dtheta);
 
-    j = joints.size() - 1;
+    double turned = 0.0;
+    GLfloat reach = 0.f;
+
+    int n = joints.size();
+    int j = n - 1;
     std::list<Joint>::reverse_iterator rjoint;
     for (rjoint = joints.rbegin(); rjoint != joints.rend(); ++rjoint) {
-        GLfloat dangle = JT_ALPHA * dtheta.getValue(j, 0);
-        rjoint->angle += dangle * 180 / M_PI;
+        reach += rjoint->length;
 
-        GLfloat lastJointX = rjoint->x;
-        GLfloat lastJointY = rjoint->y;
-        GLfloat rootX = 0.f;
-        GLfloat rootY = 0.f;
-
-        // calculate the new end effector position
-        GLfloat rendx = end.x - rjoint->x;
-        GLfloat rendy = end.y - rjoint->y;
-        end.x = rendx * cos(dangle) - rendy * sin(dangle);
-        end.y = rendy * cos(dangle) + rendx * sin(dangle);
-        end.x += rjoint->x;
-        end.y += rjoint->y;
-
-        // rotate the rest of the joints
-        std::list<Joint>::iterator ujoint;
-        for (ujoint = rjoint.base(); ujoint != joints.end(); ++ujoint) {
-            GLfloat ljx = lastJointX;
-            GLfloat ljy = lastJointY;
-
-            lastJointX = ujoint->x;
-            lastJointY = ujoint->y;
-
-            // place the joint centered at the origin translated
-            // away from the rest of the joints
-            rootX = ujoint->x - ljx + rootX;
-            rootY = ujoint->y - ljy + rootY;
-
-            // rotate the joint
-            ujoint->x = rootX * cos(dangle) - rootY * sin(dangle);
-            ujoint->y = rootY * cos(dangle) + rootX * sin(dangle);
-
-            // put it back in the correct space
-            ujoint->x += rjoint->x;
-            ujoint->y += rjoint->y;
+        GLfloat dangle = alpha * dtheta[j];
+        turned += dangle;
+
+        // joints left out of the active set don't pay for rotating
+        // the rest of the chain
+        if (dangle == 0.f) {
+            --j;
+            continue;
         }
 
+        rjoint->angle += dangle * 180 / M_PI;
+
+        rotateSuffix(--rjoint.base(), dangle, reach, n - j);
+
         --j;
     }
+
+    boundDrift();
+    return turned;
+}
+
+void Skeleton::rotateSuffix(std::list<Joint>::iterator pivot, GLfloat turn, GLfloat reach, int bones) {
+    // calculate the new end effector position
+    GLfloat rendx = end.x - pivot->x;
+    GLfloat rendy = end.y - pivot->y;
+    end.x = rendx * cos(turn) - rendy * sin(turn);
+    end.y = rendy * cos(turn) + rendx * sin(turn);
+    end.x += pivot->x;
+    end.y += pivot->y;
+
+    GLfloat lastJointX = pivot->x;
+    GLfloat lastJointY = pivot->y;
+    GLfloat rootX = 0.f;
+    GLfloat rootY = 0.f;
+
+    // rotate the rest of the joints
+    std::list<Joint>::iterator ujoint = pivot;
+    for (++ujoint; ujoint != joints.end(); ++ujoint) {
+        GLfloat ljx = lastJointX;
+        GLfloat ljy = lastJointY;
+
+        lastJointX = ujoint->x;
+        lastJointY = ujoint->y;
+
+        // place the joint centered at the origin translated
+        // away from the rest of the joints
+        rootX = ujoint->x - ljx + rootX;
+        rootY = ujoint->y - ljy + rootY;
+
+        // rotate the joint
+        ujoint->x = rootX * cos(turn) - rootY * sin(turn);
+        ujoint->y = rootY * cos(turn) + rootX * sin(turn);
+
+        // put it back in the correct space
+        ujoint->x += pivot->x;
+        ujoint->y += pivot->y;
+    }
+
+    // every moved bone rounds with coordinates no larger than the pivot's
+    // plus the reach, and is turned a little off by the rounding of the
+    // pivot's new angle. it's all charged to the pivot, which is cheaper
+    // than charging each bone, and still bounds the bones before any joint
+    // by the drift of the joints before it
+    GLfloat added = bones * (fabsf(pivot->x) + fabsf(pivot->y) + reach) * (GLfloat)(DRIFT_ULPS * FLT_EPSILON) +
+        reach * fabsf(pivot->angle) * (GLfloat)(FLT_EPSILON * M_PI / 180.0);
+    pivot->drift += added;
+    drift += added;
+}
+
+void Skeleton::boundDrift() {
+    if (!(drift > driftTolerance))
+        return;
+
+    // the prefix keeps its positions and its drift, which bounds how far
+    // the joint placed after it already is
+    GLfloat kept = 0.f;
+    int first = 0;
+    std::list<Joint>::iterator joint;
+    for (joint = joints.begin(); joint != joints.end(); ++joint) {
+        if (kept + joint->drift > 0.5f * driftTolerance)
+            break;
+        kept += joint->drift;
+        ++first;
+    }
+
+    // drift can only be over with every joint within half of it if the
+    // sum went stale, placing the last bone again brings it back
+    int n = joints.size();
+    if (first >= n) {
+        if (n == 0) {
+            drift = 0.f;
+            return;
+        }
+        first = n - 1;
+    }
+
+    computePositions(first);
+    ++anchors;
+    anchoredJoints += joints.size() - first;
+}
+
+void Skeleton::selectActiveJoints(std::vector<double> &dtheta) {
+    // every so often move every joint so none is starved for good
+    if (++activeSetIteration % ACTIVE_SET_REVISIT == 0)
+        return;
+
+    int n = joints.size();
+    if (n <= activeSetSize)
+        return;
+
+    std::vector<double> size(n);
+    double largest = 0.0;
+    for (int j = 0; j < n; j++) {
+        size[j] = fabs(dtheta[j]);
+        if (size[j] > largest) largest = size[j];
+    }
+
+    // cutoff is the smallest update still in the top activeSetSize
+    std::vector<double> ranked = size;
+    std::nth_element(ranked.begin(), ranked.begin() + (activeSetSize - 1),
+            ranked.end(), std::greater<double>());
+    double cutoff = ranked[activeSetSize - 1];
+
+    if (cutoff < ACTIVE_SET_THRESHOLD * largest)
+        cutoff = ACTIVE_SET_THRESHOLD * largest;
+
+    // ties at the cutoff may let a few more than activeSetSize through
+    for (int j = 0; j < n; j++) {
+        if (size[j] < cutoff)
+            dtheta[j] = 0.0;
+    }
+}
+
+void BroydenState::update(const std::vector<double> &dtheta, const double *moved, double alpha) {
+    double dd = 0.0;
+    for (int c = 0; c < dims; c++)
+        dd += moved[c] * moved[c];
+
+    if (dd <= 0.0) {
+        age = -1;
+        return;
+    }
+
+    // rank-1 update of the inverse so it maps the observed task space
+    // step back onto the joint step that produced it
+    double err = 0.0;
+    double step = 0.0;
+    int n = dtheta.size();
+    for (int j = 0; j < n; j++) {
+        double s = alpha * dtheta[j];
+        double r = s;
+        for (int c = 0; c < dims; c++)
+            r -= inverse[j * dims + c] * moved[c];
+
+        for (int c = 0; c < dims; c++)
+            inverse[j * dims + c] += r * moved[c] / dd;
+
+        err += r * r;
+        step += s * s;
+    }
+
+    // a poor prediction means the linearization has drifted too far
+    if (err > BROYDEN_QUALITY * BROYDEN_QUALITY * step)
+        age = -1;
+    else
+        ++age;
+}
+
+// runs body over [0, n), split across the pool when there is enough work
+static void forRange(ThreadPool *pool, int n, std::function<void(int, int)> body) {
+    if (pool && n >= PCCD_PARALLEL_MIN)
+        pool->parallelFor(0, n, body);
+    else
+        body(0, n);
+}
+
+// inclusive prefix sum: each chunk sums locally, then adds the total of
+// the chunks before it. there is a chunk per thread, far fewer than
+// forRange() would split, so they go straight to the pool
+static void prefixSum(ThreadPool *pool, std::vector<GLfloat> &v) {
+    int n = v.size();
+    int chunks = (pool && n >= PCCD_PARALLEL_MIN) ? pool->size() + 1 : 1;
+    std::vector<GLfloat> totals(chunks, 0.f);
+
+    auto overChunks = [&](std::function<void(int, int)> body) {
+        if (chunks > 1)
+            pool->parallelFor(0, chunks, body);
+        else
+            body(0, chunks);
+    };
+
+    overChunks([&](int c0, int c1) {
+        for (int c = c0; c < c1; c++) {
+            int lo = n * c / chunks;
+            int hi = n * (c + 1) / chunks;
+            for (int j = lo + 1; j < hi; j++)
+                v[j] += v[j - 1];
+            totals[c] = (hi > lo) ? v[hi - 1] : 0.f;
+        }
+    });
+
+    for (int c = 1; c < chunks; c++)
+        totals[c] += totals[c - 1];
+
+    overChunks([&](int c0, int c1) {
+        for (int c = (c0 > 0 ? c0 : 1); c < c1; c++) {
+            int lo = n * c / chunks;
+            int hi = n * (c + 1) / chunks;
+            for (int j = lo; j < hi; j++)
+                v[j] += totals[c - 1];
+        }
+    });
+}
+
+void Skeleton::solveIKwithParallelCCD(EndTarget target) {
+    int n = joints.size();
+    if (n == 0)
+        return;
+
+    std::vector<GLfloat> xs(n), ys(n), angles(n), lengths(n);
+
+    int j = 0;
+    std::list<Joint>::iterator joint;
+    for (joint = joints.begin(); joint != joints.end(); ++joint, ++j) {
+        xs[j] = joint->x;
+        ys[j] = joint->y;
+        angles[j] = joint->angle;
+        lengths[j] = joint->length;
+    }
+
+    // every joint's ccd rotation is taken from the same snapshot, so they
+    // are independent. each is scaled by its share of the over-relaxation
+    GLfloat weight = PCCD_DAMPING / n;
+    GLfloat endX = end.x;
+    GLfloat endY = end.y;
+
+    forRange(pool, n, [&](int lo, int hi) {
+        for (int j = lo; j < hi; j++) {
+            GLfloat ap = atan2(target.y - ys[j], target.x - xs[j]) -
+                atan2(endY - ys[j], endX - xs[j]);
+            if (ap > M_PI) ap -= 2.f * M_PI;
+            if (ap < -M_PI) ap += 2.f * M_PI;
+
+            angles[j] = clamp(angles[j] + weight * ap * 180.f / M_PI);
+        }
+    });
+
+    // on one thread the prefix sums below buy nothing, and placing the
+    // chain the usual way leaves it without drift
+    if (!pool || n < PCCD_PARALLEL_MIN) {
+        j = 0;
+        for (joint = joints.begin(); joint != joints.end(); ++joint, ++j)
+            joint->angle = angles[j];
+
+        computePositions();
+        return;
+    }
+
+    // forward kinematics in one pass: world angles are a prefix sum of the
+    // joint angles, positions a prefix sum of the bone vectors
+    std::vector<GLfloat> world = angles;
+    prefixSum(pool, world);
+
+    forRange(pool, n, [&](int lo, int hi) {
+        for (int j = lo; j < hi; j++) {
+            GLfloat a = world[j] * M_PI / 180.f;
+            xs[j] = lengths[j] * cos(a);
+            ys[j] = lengths[j] * sin(a);
+        }
+    });
+
+    prefixSum(pool, xs);
+    prefixSum(pool, ys);
+
+    GLfloat lastX = root_x;
+    GLfloat lastY = root_y;
+
+    // every position is new, so is the drift: the sums round differently
+    // from computePositions(), by up to an epsilon of each partial sum of
+    // the world angles (turning the bones after it), of the bone and of
+    // the partial sums of the positions
+    GLfloat turned = 0.f;
+    drift = 0.f;
+
+    j = 0;
+    for (joint = joints.begin(); joint != joints.end(); ++joint, ++j) {
+        joint->x = lastX;
+        joint->y = lastY;
+        joint->angle = angles[j];
+
+        lastX = root_x + xs[j];
+        lastY = root_y + ys[j];
+
+        turned += fabsf(world[j]) * FLT_EPSILON;
+        GLfloat scale = lengths[j] + fabsf(xs[j]) + fabsf(ys[j]) + fabsf(lastX) + fabsf(lastY);
+        joint->drift = DRIFT_ULPS * (scale * FLT_EPSILON + lengths[j] * turned * (GLfloat)(M_PI / 180.0));
+        drift += joint->drift;
+    }
+
+    end.x = lastX;
+    end.y = lastY;
+
+    boundDrift();
 }
 
+void Skeleton::solveIKwithFABRIK(EndTarget target) {
+    // backward pass: pin the end effector to the target and pull
+    // each joint back along its bone towards the previous one
+    GLfloat nextX = target.x;
+    GLfloat nextY = target.y;
+
+    std::list<Joint>::reverse_iterator rjoint;
+    for (rjoint = joints.rbegin(); rjoint != joints.rend(); ++rjoint) {
+        GLfloat dx = rjoint->x - nextX;
+        GLfloat dy = rjoint->y - nextY;
+        GLfloat dist = sqrtf(dx * dx + dy * dy);
+
+        if (dist > 0.f) {
+            rjoint->x = nextX + dx * rjoint->length / dist;
+            rjoint->y = nextY + dy * rjoint->length / dist;
+        } else {
+            rjoint->x = nextX - rjoint->length;
+            rjoint->y = nextY;
+        }
+
+        nextX = rjoint->x;
+        nextY = rjoint->y;
+    }
+
+    // forward pass: pin the first joint back to the root and push
+    // each following joint (and the end effector) out along its bone
+    GLfloat lastX = root_x;
+    GLfloat lastY = root_y;
+
+    std::list<Joint>::iterator joint;
+    for (joint = joints.begin(); joint != joints.end(); ++joint) {
+        joint->x = lastX;
+        joint->y = lastY;
+
+        std::list<Joint>::iterator next = joint;
+        ++next;
+
+        GLfloat tx = (next == joints.end()) ? target.x : next->x;
+        GLfloat ty = (next == joints.end()) ? target.y : next->y;
+
+        GLfloat dx = tx - joint->x;
+        GLfloat dy = ty - joint->y;
+        GLfloat dist = sqrtf(dx * dx + dy * dy);
+
+        if (dist > 0.f) {
+            lastX = joint->x + dx * joint->length / dist;
+            lastY = joint->y + dy * joint->length / dist;
+        } else {
+            lastX = joint->x + joint->length;
+            lastY = joint->y;
+        }
+    }
+
+    end.x = lastX;
+    end.y = lastY;
+}
+
+void Skeleton::computeAngles() {
+    // each angle is relative to the direction of the previous bone,
+    // the first bone is relative to the x axis
+    GLfloat lastAngle = 0.f;
+    drift = 0.f;
+
+    std::list<Joint>::iterator joint;
+    for (joint = joints.begin(); joint != joints.end(); ++joint) {
+        std::list<Joint>::iterator next = joint;
+        ++next;
+
+        GLfloat nx = (next == joints.end()) ? end.x : next->x;
+        GLfloat ny = (next == joints.end()) ? end.y : next->y;
+
+        GLfloat boneAngle = atan2(ny - joint->y, nx - joint->x) * 180.f / M_PI;
+        joint->angle = clamp(boneAngle - lastAngle);
+
+        // the positions were moved freely, the angles only match them to
+        // within the rounding of the bone's direction and length
+        joint->drift = DRIFT_ULPS * FLT_EPSILON * (fabsf(joint->x) + fabsf(joint->y) +
+                joint->length * (1.f + fabsf(boneAngle) * M_PI / 180.f));
+        drift += joint->drift;
+
+        lastAngle = boneAngle;
+    }
+}
+
+void Skeleton::computePositions() {
+    computePositions(0);
+}
+
+void Skeleton::computePositions(int first) {
+    // at least the last bone is placed, or the end would be left at the root
+    if (first >= (int)joints.size())
+        first = joints.size() - 1;
+
+    GLfloat x = root_x;
+    GLfloat y = root_y;
+    GLfloat a = 0.f;
+    GLfloat kept = 0.f;
+
+    int j = 0;
+    std::list<Joint>::iterator joint;
+    for (joint = joints.begin(); joint != joints.end(); ++joint, ++j) {
+        // the prefix only adds up its angles, no trig
+        if (j < first) {
+            kept += joint->drift;
+            a += joint->angle * M_PI / 180.f;
+            continue;
+        }
+
+        if (j > 0 && j == first) {
+            x = joint->x;
+            y = joint->y;
+        }
+
+        joint->x = x;
+        joint->y = y;
+        joint->drift = 0.f;
+
+        a += joint->angle * M_PI / 180.f;
+        x += joint->length * cos(a);
+        y += joint->length * sin(a);
+    }
+
+    end.x = x;
+    end.y = y;
+    drift = kept;
+}
+
+// solves a two bone chain rooted at the origin for the target (tx, ty)
+// using the law of cosines, writing the world space angles (radians) of
+// both bones. targets too close or too far are clamped to the nearest pose
+static void solveTwoBones(GLfloat l1, GLfloat l2, GLfloat tx, GLfloat ty,
+        bool elbowUp, GLfloat *a1, GLfloat *a2) {
+    GLfloat d2 = tx * tx + ty * ty;
+
+    GLfloat c = (d2 - l1 * l1 - l2 * l2) / (2.f * l1 * l2);
+    if (c > 1.f) c = 1.f;
+    if (c < -1.f) c = -1.f;
+
+    GLfloat bend = acos(c);
+    if (!elbowUp) bend = -bend;
+
+    *a1 = atan2(ty, tx) - atan2(l2 * sin(bend), l1 + l2 * cos(bend));
+    *a2 = *a1 + bend;
+}
+
+bool Skeleton::solveIKAnalytic(EndTarget target) {
+    if (joints.size() != 3)
+        return solveIKAnalytic(target, 0.f);
+
+    // reach the target's orientation if it has one, otherwise keep the
+    // current orientation of the last bone
+    if (target.oriented)
+        return solveIKAnalytic(target, target.angle);
+
+    GLfloat phi = 0.f;
+    std::list<Joint>::iterator joint;
+    for (joint = joints.begin(); joint != joints.end(); ++joint)
+        phi += joint->angle;
+
+    return solveIKAnalytic(target, phi);
+}
+
+bool Skeleton::solveIKAnalytic(EndTarget target, GLfloat phi) {
+    if (joints.empty())
+        return false;
+
+    GLfloat tx = target.x - root_x;
+    GLfloat ty = target.y - root_y;
+    GLfloat dist = sqrtf(tx * tx + ty * ty);
+
+    GLfloat reach = 0.f;
+    std::list<Joint>::iterator joint;
+    for (joint = joints.begin(); joint != joints.end(); ++joint)
+        reach += joint->length;
+
+    // out of reach (or a single bone): point the whole chain at the target
+    if (dist >= reach || joints.size() == 1) {
+        joints.front().angle = atan2(ty, tx) * 180.f / M_PI;
+        for (joint = ++joints.begin(); joint != joints.end(); ++joint)
+            joint->angle = 0.f;
+
+        computePositions();
+        return true;
+    }
+
+    if (joints.size() > 3)
+        return false;
+
+    std::list<Joint>::iterator j1 = joints.begin();
+    std::list<Joint>::iterator j2 = j1;
+    ++j2;
+
+    // keep bending the elbow the way it currently is
+    bool elbowUp = j2->angle >= 0.f;
+    GLfloat a1, a2;
+
+    if (joints.size() == 2) {
+        solveTwoBones(j1->length, j2->length, tx, ty, elbowUp, &a1, &a2);
+
+        j1->angle = clamp(a1 * 180.f / M_PI);
+        j2->angle = clamp((a2 - a1) * 180.f / M_PI);
+    } else {
+        std::list<Joint>::iterator j3 = j2;
+        ++j3;
+
+        // place the wrist so the last bone ends on the target with the
+        // requested orientation, if it can't be reached point the last
+        // bone along the root to target direction instead
+        GLfloat a3 = phi * M_PI / 180.f;
+        GLfloat wx = tx - j3->length * cos(a3);
+        GLfloat wy = ty - j3->length * sin(a3);
+        GLfloat wd = sqrtf(wx * wx + wy * wy);
+
+        if (wd > j1->length + j2->length || wd < fabs(j1->length - j2->length)) {
+            a3 = atan2(ty, tx);
+            wx = tx - j3->length * cos(a3);
+            wy = ty - j3->length * sin(a3);
+        }
+
+        solveTwoBones(j1->length, j2->length, wx, wy, elbowUp, &a1, &a2);
+
+        j1->angle = clamp(a1 * 180.f / M_PI);
+        j2->angle = clamp((a2 - a1) * 180.f / M_PI);
+        j3->angle = clamp((a3 - a2) * 180.f / M_PI);
+    }
+
+    computePositions();
+    return true;
+}
+
+int iterationLimit(IKMethod method) {
+    switch (method) {
+        case IK_CCD:            return NUM_CCD_ITERS;
+        case IK_PARALLEL_CCD:   return NUM_PCCD_ITERS;
+        case IK_FABRIK:         return NUM_FAB_ITERS;
+        default:                return NUM_JAC_ITERS;
+    }
+}
+
+SolverConfig::SolverConfig(IKMethod m) : method(m), iterations(iterationLimit(m)), alpha(JT_ALPHA) {
+    switch (m) {
+        case IK_CCD:
+        case IK_PARALLEL_CCD:   epsilon = CCD_EPSILON; break;
+        case IK_FABRIK:         epsilon = FAB_EPSILON; break;
+        default:                epsilon = JAC_EPSILON; break;
+    }
+}
+
+SolverConfig Skeleton::configFor(IKMethod method) const {
+    return (method == IK_AUTO) ? autoConfig : SolverConfig(method);
+}
+
+bool Skeleton::stepIK(EndTarget target, IKMethod method) {
+    return stepIK(target, configFor(method));
+}
+
+bool Skeleton::stepIK(EndTarget target, const SolverConfig &config) {
+    // IK_AUTO stands for whatever autoConfig holds, which is always a
+    // method of its own
+    if (config.method == IK_AUTO)
+        return stepIK(target, autoConfig);
+
+    GLfloat ox = end.x;
+    GLfloat oy = end.y;
+
+    switch (config.method) {
+        case IK_CCD:
+            solveIKwithCCD(target);
+            break;
+
+        case IK_PARALLEL_CCD:
+            solveIKwithParallelCCD(target);
+            break;
+
+        case IK_TRANSPOSE:
+            solveIKwithJacobian(target, TRANSPOSE, config.alpha);
+            break;
+
+        case IK_PSEUDOINVERSE:
+            solveIKwithJacobian(target, PSEUDOINVERSE, config.alpha);
+            break;
+
+        case IK_BROYDEN:
+            solveIKwithJacobian(target, BROYDEN, config.alpha);
+            break;
+
+        case IK_FABRIK:
+            solveIKwithFABRIK(target);
+            break;
+
+        case IK_AUTO:
+            break;
+    }
+
+    GLfloat dx = target.x - end.x;
+    GLfloat dy = target.y - end.y;
+    GLfloat sx = end.x - ox;
+    GLfloat sy = end.y - oy;
+
+    switch (config.method) {
+        case IK_CCD:
+        case IK_PARALLEL_CCD:
+            return sqrtf(dx * dx + dy * dy) < config.epsilon;
+
+        case IK_FABRIK:
+            // stop once we either reach the target or stall (e.g. the
+            // target is out of reach)
+            return sqrtf(dx * dx + dy * dy) < config.epsilon ||
+                sqrtf(sx * sx + sy * sy) < JAC_EPSILON;
+
+        default:
+            return sqrtf(sx * sx + sy * sy) < config.epsilon;
+    }
+}
+
+int Skeleton::solveIK(EndTarget target, IKMethod method, const std::atomic<bool> *cancel) {
+    return solveIK(target, configFor(method), cancel);
+}
+
+int Skeleton::solveIK(EndTarget target, const SolverConfig &config, const std::atomic<bool> *cancel) {
+    if (config.method == IK_AUTO)
+        return solveIK(target, autoConfig, cancel);
+
+    // short chains and unreachable targets are solved in constant time
+    if (solveIKAnalytic(target))
+        return 1;
+
+    // common joint counts have unrolled, allocation free solvers
+    int fixed = solveIKFixed(*this, target, config, cancel);
+    if (fixed >= 0)
+        return fixed;
+
+    int i = 0;
+    while (i < config.iterations && !(cancel && *cancel)) {
+        ++i;
+        if (stepIK(target, config))
+            break;
+    }
+
+    if (config.method == IK_FABRIK)
+        computeAngles();
+
+    return i;
+}
@@ -9,7 +9,55 @@
 #ifndef _IKSKEL_H_
 #define _IKSKEL_H_
 
+#include <atomic>
 #include <list>
+#include <vector>
+
+#include "ikprecision.h"
+#include "iksvd.h"
+
+// number of times we run each solver before termination
+#define NUM_CCD_ITERS 100
+#define NUM_JAC_ITERS 100
+#define NUM_FAB_ITERS 100
+#define NUM_PCCD_ITERS 200
+
+// how close we need to get to terminate each solver
+#define CCD_EPSILON 0.01
+#define JAC_EPSILON 0.0001
+#define FAB_EPSILON 0.001
+
+// step size of the jacobian methods
+#define JT_ALPHA 0.05
+
+// scale of the orientation row of the jacobian relative to position
+#define ORIENT_WEIGHT 0.1
+
+// iterations between full rebuilds of the broyden pseudoinverse, and the
+// relative error in its predicted joint step that forces an early rebuild
+#define BROYDEN_REFRESH 10
+#define BROYDEN_QUALITY 0.5
+
+// positions rotated in place by ccd and the jacobian methods are placed
+// again from the angles once the end effector's error bound passes
+// DRIFT_TOLERANCE (world units, well under a pixel). each rotation is
+// taken to round by DRIFT_ULPS float epsilons of the coordinates it
+// works with
+#define DRIFT_TOLERANCE 1e-3f
+#define DRIFT_ULPS 4
+
+// jacobian updates smaller than this fraction of the largest one are
+// skipped in active set mode, and every ACTIVE_SET_REVISIT iterations
+// all joints are updated regardless
+#define ACTIVE_SET_THRESHOLD 0.1
+#define ACTIVE_SET_REVISIT 8
+
+// over-relaxation of parallel ccd: each joint turns by PCCD_DAMPING / n
+// of its own ccd rotation per iteration, so the blend of all of them
+// overshoots their average by half. and the chain length below which it
+// stays on one thread
+#define PCCD_DAMPING 1.5
+#define PCCD_PARALLEL_MIN 256
 
 __inline__ GLfloat clamp(GLfloat x) {
     if (x < -180.f) x += 360.f;
@@ -17,11 +65,22 @@ __inline__ GLfloat clamp(GLfloat x) {
     return x;
 }
 
+__inline__ double clamp(double x) {
+    if (x < -180.0) x += 360.0;
+    if (x > 180.0) x -= 360.0;
+    return x;
+}
+
 struct Joint {
     bool active = false;
     GLfloat x, y;
     GLfloat angle, length;
 
+    // bound on the error against the forward kinematics of the angles
+    // that rotations about this joint have left in the bones after it
+    // (or that computeAngles() left in this joint's bone)
+    GLfloat drift = 0.f;
+
     Joint (GLfloat xp, GLfloat yp, GLfloat a, GLfloat l) :
         x(xp), y(yp), angle(a), length(l) { };
 };
@@ -29,23 +88,163 @@ struct Joint {
 struct EndTarget {
     bool active = false;
     GLfloat x, y;
+
+    // optional world space orientation (degrees) of the last bone, only
+    // used by the jacobian methods and the closed form three joint solve
+    bool oriented = false;
+    GLfloat angle = 0.f;
+};
+
+// a snapshot of a skeleton's joint angles and end effector position
+struct Pose {
+    std::vector<GLfloat> angles;
+    GLfloat end_x, end_y;
 };
 
-enum JacobianMethod { TRANSPOSE, PSEUDOINVERSE };
+enum JacobianMethod { TRANSPOSE, PSEUDOINVERSE, BROYDEN };
+
+// IK_AUTO solves with whatever configuration was tuned for the skeleton
+enum IKMethod { IK_CCD, IK_TRANSPOSE, IK_PSEUDOINVERSE, IK_FABRIK, IK_BROYDEN,
+    IK_PARALLEL_CCD, IK_AUTO };
+
+const char *methodName(IKMethod method);
+int iterationLimit(IKMethod method);
+
+// the parameters of a solve: the method, its iteration limit, the
+// distance that terminates it (from the end effector to the target for
+// ccd and fabrik, the end effector's step for the jacobian methods) and
+// the jacobian step size. built from a method alone it holds the macros
+struct SolverConfig {
+    IKMethod method;
+    int iterations;
+    double epsilon;
+    double alpha;
+
+    explicit SolverConfig(IKMethod m = IK_PSEUDOINVERSE);
+};
+
+class ThreadPool;
+
+// quasi-newton estimate of the jacobian pseudoinverse, kept between
+// iterations and corrected with rank-1 (broyden) updates
+struct BroydenState {
+    // row major joints x dims, dims being the task space dimension
+    std::vector<double> inverse;
+    int dims = 0;
+
+    // iterations since the last rebuild, -1 when a rebuild is needed
+    int age = -1;
+
+    // moved is the task space step (dims values) taken by alpha * dtheta
+    void update(const std::vector<double> &dtheta, const double *moved, double alpha = JT_ALPHA);
+};
+
+// buffers reused by every jacobian iteration
+struct JacobianWorkspace {
+    std::vector<double> v, jacobian, jjt, jjinverse, pinv, dtheta;
+    SVDWorkspace svd;
+};
 
 struct Skeleton {
     bool active = false;
     bool frozen = false;
     std::list<Joint> joints;
     EndTarget end;
+    BroydenState broyden;
+    JacobianWorkspace work;
 
     GLfloat root_x, root_y;
 
+    // when > 0 the jacobian methods only move this many joints per
+    // iteration, those with the largest updates
+    int activeSetSize = 0;
+    int activeSetIteration = 0;
+
+    // precision of the fixed size solvers, the list based solvers always
+    // store GLfloat and build their jacobians in double
+    Precision precision = PRECISION_FLOAT;
+
+    // spreads the parallel solvers over these threads, if set
+    ThreadPool *pool = NULL;
+
+    // what IK_AUTO solves with: the pseudoinverse with the default
+    // parameters until tuneSkeleton() has profiled the skeleton
+    SolverConfig autoConfig;
+    bool autoTuned = false;
+
+    // autoConfig for IK_AUTO, the defaults for any other method
+    SolverConfig configFor(IKMethod method) const;
+
+    // bound on how far the end effector is from where the forward
+    // kinematics of the angles puts it: the sum of the joints' drift, the
+    // most any joint can be off. past driftTolerance the joints after the
+    // longest prefix still within half of it are placed again from the
+    // angles (INFINITY never does). anchors counts those re-placements,
+    // anchoredJoints the joints they placed
+    GLfloat drift = 0.f;
+    GLfloat driftTolerance = DRIFT_TOLERANCE;
+    long anchors = 0;
+    long anchoredJoints = 0;
+
     void freezeSkeleton();
     void resetSkeleton();
 
+    Pose getPose();
+    void setPose(const Pose &pose);
+
     void solveIKwithCCD(EndTarget target);
-    void solveIKwithJacobian(EndTarget target, JacobianMethod method);
+    void solveIKwithJacobian(EndTarget target, JacobianMethod method, double alpha = JT_ALPHA);
+
+    // pieces of a jacobian iteration, all working on the buffers in work:
+    // the task space error (returns its dimension m), the m x n jacobian,
+    // J J^T, and J^+ = J^T (J J^T)^+ from an already inverted J J^T
+    int computeTaskError(EndTarget target);
+    void buildJacobian(int m);
+    void computeJJT(int m);
+    void composePseudoInverse(int m, std::vector<double> &total);
+
+    // rotates every joint by alpha * dtheta, returns the total turn
+    double applyJointStep(std::vector<double> &dtheta, double alpha = JT_ALPHA);
+    void selectActiveJoints(std::vector<double> &dtheta);
+
+    // only moves the joint positions, the angles are recovered
+    // by computeAngles() once the solver has terminated
+    void solveIKwithFABRIK(EndTarget target);
+    void computeAngles();
+
+    // jacobi style ccd: every joint's rotation comes from the same pose,
+    // they are blended and then applied in one forward kinematics pass
+    void solveIKwithParallelCCD(EndTarget target);
+
+    // recomputes the joint and end effector positions from the angles,
+    // all of them, or those after joint first, which stays where it is
+    void computePositions();
+    void computePositions(int first);
+
+    // turns the end effector and every joint after pivot about it by turn
+    // radians (pivot's angle already includes it), and grows pivot's drift.
+    // reach is the length of the bones from pivot on, bones their number
+    void rotateSuffix(std::list<Joint>::iterator pivot, GLfloat turn, GLfloat reach, int bones);
+
+    // re-places the drifted part of the chain once drift passes
+    // driftTolerance
+    void boundDrift();
+
+    // closed form solve for chains of up to three joints and for targets
+    // out of reach, returns false if the chain needs an iterative solver.
+    // phi is the world space angle (degrees) of the last bone of a three
+    // joint chain, by default its current orientation is kept
+    bool solveIKAnalytic(EndTarget target);
+    bool solveIKAnalytic(EndTarget target, GLfloat phi);
+
+    // one iteration of a solver, returns true once it has terminated
+    bool stepIK(EndTarget target, IKMethod method);
+    bool stepIK(EndTarget target, const SolverConfig &config);
+
+    // runs a solver until it terminates (or cancel is set), returns the
+    // iterations used
+    int solveIK(EndTarget target, IKMethod method, const std::atomic<bool> *cancel = NULL);
+    int solveIK(EndTarget target, const SolverConfig &config, const std::atomic<bool> *cancel = NULL);
 };
 
 #endif
@@ -0,0 +1,511 @@
+/*
+ * iksolverd.cpp
+ * =============
+ *
+ * keeps the rigs of a skeleton library resident and solves batches of
+ * targets for other processes over a unix domain socket (ikproto.h)
+ *
+ *   iksolverd <rigs.iklb> [socket] [threads]
+ *
+ * one thread reads requests and writes results for every connection, the
+ * solves run on a thread pool. a connection isn't read while too many of
+ * its targets are unsolved or too many bytes of its results are unsent,
+ * so a client that sends faster than it is served, or doesn't collect its
+ * results, is held back by its own socket instead of growing the daemon's
+ * queues. SIGINT or SIGTERM stops it and prints the stats
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "iklib.h"
+#include "ikpool.h"
+#include "ikproto.h"
+#include "ikskel.h"
+#include "iktune.h"
+
+// per connection: targets accepted but not yet answered, and bytes of
+// results not yet sent, past which it stops being read
+#define SERVICE_MAX_INFLIGHT (4 * PROTO_MAX_TARGETS)
+#define SERVICE_MAX_PENDING (8 << 20)
+
+// bytes read from a connection at a time
+#define SERVICE_READ_SIZE 65536
+
+typedef std::chrono::steady_clock Clock;
+
+struct Connection {
+    int fd;
+    std::vector<char> in;
+
+    // the rest is shared with the workers
+    std::mutex lock;
+    std::vector<char> out;
+    size_t sent = 0;
+    long inflight = 0;
+
+    // not being read because of backpressure, and done reading (the peer
+    // shut down or sent garbage) but results are still on their way
+    bool stalled = false;
+    bool closing = false;
+
+    Connection(int f) : fd(f) { }
+};
+
+struct Request {
+    std::shared_ptr<Connection> connection;
+    SolveRequest solve;
+    Clock::time_point received, deadline;
+    std::atomic<int> remaining;
+};
+
+static SkeletonLibrary library;
+
+// each rig's rest pose, built the first time it is asked for and tuned
+// the first time it is solved with IK_AUTO. tuning takes a while, so it
+// runs once per rig outside rigLock
+static std::vector<Skeleton *> rigs;
+static std::unique_ptr<std::once_flag[]> tuneOnce;
+static std::mutex rigLock;
+
+static ServiceStats stats;
+static LatencyHistogram latency;
+static std::mutex statsLock;
+
+// written to by the workers and the signal handler to wake up poll()
+static int wakeFds[2];
+static volatile sig_atomic_t stopping = 0;
+
+static void wake() {
+    char byte = 0;
+    if (write(wakeFds[1], &byte, 1) < 0) {
+        // the pipe is full, poll() will wake up anyway
+    }
+}
+
+static void stop(int) {
+    stopping = 1;
+    wake();
+}
+
+// a copy, taken under the lock since another request may be installing
+// the tuned configuration of the same rig
+static Skeleton restSkeleton(uint32_t index, IKMethod method) {
+    Skeleton skel;
+    {
+        std::lock_guard<std::mutex> guard(rigLock);
+        if (!rigs[index]) {
+            RigView view;
+            library.rig(index, view);
+            rigs[index] = new Skeleton(buildSkeleton(view));
+        }
+        skel = *rigs[index];
+    }
+    if (method != IK_AUTO || skel.autoTuned)
+        return skel;
+
+    // the first request tunes its copy, the others for this rig wait for
+    // it while requests for other rigs go on
+    std::call_once(tuneOnce[index], [&] {
+        tuneSkeleton(skel);
+        std::lock_guard<std::mutex> guard(rigLock);
+        rigs[index]->autoConfig = skel.autoConfig;
+        rigs[index]->autoTuned = true;
+    });
+
+    std::lock_guard<std::mutex> guard(rigLock);
+    return *rigs[index];
+}
+
+static ServiceStats snapshot() {
+    std::lock_guard<std::mutex> guard(statsLock);
+    ServiceStats current = stats;
+    current.p50 = latency.percentile(0.5);
+    current.p90 = latency.percentile(0.9);
+    current.p99 = latency.percentile(0.99);
+    current.max = latency.largest;
+    return current;
+}
+
+// runs on the pool: solves targets [first, first + count) of a request,
+// each from the rig's rest pose, and queues their results
+static void solveChunk(std::shared_ptr<Request> request, uint32_t first, uint32_t count) {
+    Connection &connection = *request->connection;
+    {
+        // nobody is left to take the results
+        std::lock_guard<std::mutex> guard(connection.lock);
+        if (connection.fd < 0) {
+            connection.inflight -= count;
+            return;
+        }
+    }
+
+    IKMethod method = (IKMethod)request->solve.method;
+    Skeleton skel = restSkeleton(request->solve.rig, method);
+    Pose rest = skel.getPose();
+    bool deadline = request->solve.deadline != 0;
+
+    SolveResults results;
+    results.id = request->solve.id;
+    results.first = first;
+    results.count = count;
+    results.joints = rest.angles.size();
+    results.angles.reserve(count * results.joints);
+
+    int expired = 0;
+    for (uint32_t t = first; t < first + count; t++) {
+        EndTarget target;
+        target.active = true;
+        target.x = request->solve.targets[2 * t];
+        target.y = request->solve.targets[2 * t + 1];
+
+        skel.setPose(rest);
+        skel.broyden = BroydenState();
+
+        // a solve that has started runs to the end, so a deadline is
+        // overrun by at most one solve per worker
+        bool late = deadline && Clock::now() > request->deadline;
+        int iterations = 0;
+        if (late)
+            ++expired;
+        else
+            iterations = skel.solveIK(target, method);
+
+        results.state.push_back(late ? PROTO_EXPIRED : PROTO_SOLVED);
+        results.iterations.push_back(iterations);
+        results.residual.push_back(sqrtf((target.x - skel.end.x) * (target.x - skel.end.x) +
+                (target.y - skel.end.y) * (target.y - skel.end.y)));
+
+        std::list<Joint>::iterator joint;
+        for (joint = skel.joints.begin(); joint != skel.joints.end(); ++joint)
+            results.angles.push_back(joint->angle);
+    }
+
+    std::vector<char> frame;
+    encodeResults(frame, results);
+
+    {
+        std::lock_guard<std::mutex> guard(connection.lock);
+        if (connection.fd >= 0)
+            connection.out.insert(connection.out.end(), frame.begin(), frame.end());
+        connection.inflight -= count;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(statsLock);
+        stats.targets += count;
+        stats.expired += expired;
+        if (--request->remaining == 0) {
+            latency.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                        Clock::now() - request->received).count());
+        }
+    }
+
+    wake();
+}
+
+static void reject(Connection &connection, uint32_t id, const std::string &message) {
+    std::lock_guard<std::mutex> guard(connection.lock);
+    encodeError(connection.out, id, message);
+
+    std::lock_guard<std::mutex> statsGuard(statsLock);
+    ++stats.rejected;
+}
+
+static void handleFrame(std::shared_ptr<Connection> connection, const char *frame, size_t size,
+        ThreadPool &pool) {
+    uint32_t kind, id;
+    frameHeader(frame, kind, id);
+
+    if (kind == PROTO_STATS) {
+        ServiceStats current = snapshot();
+        std::lock_guard<std::mutex> guard(connection->lock);
+        encodeStats(connection->out, id, current);
+        return;
+    }
+
+    if (kind != PROTO_SOLVE) {
+        reject(*connection, id, "unknown frame kind " + std::to_string(kind));
+        return;
+    }
+
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->connection = connection;
+    request->received = Clock::now();
+
+    RigView view;
+    SolveRequest &solve = request->solve;
+    if (!decodeSolve(frame, size, solve)) {
+        reject(*connection, id, "malformed solve request");
+        return;
+    }
+    if (solve.rig >= (uint32_t)library.size() || !library.rig(solve.rig, view) || view.count == 0) {
+        reject(*connection, id, "no rig " + std::to_string(solve.rig));
+        return;
+    }
+    if (solve.method > IK_AUTO) {
+        reject(*connection, id, "unknown method " + std::to_string(solve.method));
+        return;
+    }
+
+    uint32_t count = solve.targets.size() / 2;
+    request->deadline = request->received + std::chrono::microseconds(solve.deadline);
+
+    {
+        std::lock_guard<std::mutex> guard(statsLock);
+        ++stats.requests;
+    }
+
+    // an empty batch is answered at once, so the client sees it finish
+    if (count == 0) {
+        SolveResults results;
+        results.id = id;
+        results.first = results.count = 0;
+        results.joints = view.count;
+
+        std::lock_guard<std::mutex> guard(connection->lock);
+        encodeResults(connection->out, results);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(connection->lock);
+        connection->inflight += count;
+    }
+
+    int chunks = (count + PROTO_CHUNK - 1) / PROTO_CHUNK;
+    request->remaining = chunks;
+    for (int c = 0; c < chunks; c++) {
+        uint32_t first = c * PROTO_CHUNK;
+        uint32_t size = std::min((uint32_t)PROTO_CHUNK, count - first);
+        pool.submit([request, first, size]() { solveChunk(request, first, size); });
+    }
+}
+
+// returns false once the connection should be dropped
+static bool readFrames(std::shared_ptr<Connection> connection, ThreadPool &pool) {
+    char buffer[SERVICE_READ_SIZE];
+    ssize_t n = recv(connection->fd, buffer, sizeof(buffer), 0);
+    if (n < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    if (n == 0) {
+        // the peer is done sending, but may still want its results
+        std::lock_guard<std::mutex> guard(connection->lock);
+        connection->closing = true;
+        return true;
+    }
+
+    std::vector<char> &in = connection->in;
+    in.insert(in.end(), buffer, buffer + n);
+
+    size_t offset = 0;
+    for (;;) {
+        long size = frameSize(in.data() + offset, in.size() - offset);
+        if (size == 0)
+            break;
+
+        if (size < 0) {
+            // the stream can't be followed past a bad header
+            reject(*connection, 0, "frame too large");
+            in.clear();
+
+            std::lock_guard<std::mutex> guard(connection->lock);
+            connection->closing = true;
+            return true;
+        }
+
+        handleFrame(connection, in.data() + offset, size, pool);
+        offset += size;
+    }
+    in.erase(in.begin(), in.begin() + offset);
+    return true;
+}
+
+// returns false once the connection should be dropped
+static bool flush(Connection &connection) {
+    std::lock_guard<std::mutex> guard(connection.lock);
+
+    while (connection.sent < connection.out.size()) {
+        ssize_t n = send(connection.fd, connection.out.data() + connection.sent,
+                connection.out.size() - connection.sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                break;
+            return false;
+        }
+        connection.sent += n;
+    }
+
+    // drop what has been sent once it is a good part of the buffer
+    if (connection.sent == connection.out.size()) {
+        connection.out.clear();
+        connection.sent = 0;
+    } else if (connection.sent > SERVICE_READ_SIZE && connection.sent > connection.out.size() / 2) {
+        connection.out.erase(connection.out.begin(), connection.out.begin() + connection.sent);
+        connection.sent = 0;
+    }
+
+    return !connection.closing || connection.inflight > 0 || !connection.out.empty();
+}
+
+static void serve(int listener, ThreadPool &pool) {
+    std::vector<std::shared_ptr<Connection> > connections;
+    std::vector<pollfd> fds;
+
+    while (!stopping) {
+        fds.clear();
+        fds.push_back({ listener, POLLIN, 0 });
+        fds.push_back({ wakeFds[0], POLLIN, 0 });
+
+        for (size_t c = 0; c < connections.size(); c++) {
+            Connection &connection = *connections[c];
+            std::lock_guard<std::mutex> guard(connection.lock);
+
+            short events = 0;
+            if (connection.sent < connection.out.size())
+                events |= POLLOUT;
+
+            if (!connection.closing) {
+                bool full = connection.inflight >= SERVICE_MAX_INFLIGHT ||
+                    connection.out.size() - connection.sent >= SERVICE_MAX_PENDING;
+                if (!full)
+                    events |= POLLIN;
+                else if (!connection.stalled) {
+                    std::lock_guard<std::mutex> statsGuard(statsLock);
+                    ++stats.stalls;
+                }
+                connection.stalled = full;
+            }
+
+            fds.push_back({ connection.fd, events, 0 });
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "poll failed: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char drain[256];
+            while (read(wakeFds[0], drain, sizeof(drain)) > 0) { }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listener, NULL, NULL)) >= 0) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                connections.push_back(std::make_shared<Connection>(fd));
+
+                std::lock_guard<std::mutex> guard(statsLock);
+                ++stats.connections;
+            }
+        }
+
+        // connections accepted above have no entry in fds yet
+        size_t polled = fds.size() - 2;
+        for (size_t c = connections.size(); c-- > 0; ) {
+            std::shared_ptr<Connection> connection = connections[c];
+            short revents = c < polled ? fds[c + 2].revents : 0;
+
+            // a hung up peer can't take its results any more
+            bool keep = !(revents & (POLLHUP | POLLERR));
+            if (keep && (revents & POLLIN))
+                keep = readFrames(connection, pool);
+            if (keep)
+                keep = flush(*connection);
+
+            if (!keep) {
+                std::lock_guard<std::mutex> guard(connection->lock);
+                close(connection->fd);
+                connection->fd = -1;
+                connections.erase(connections.begin() + c);
+            }
+        }
+    }
+
+    for (size_t c = 0; c < connections.size(); c++) {
+        std::lock_guard<std::mutex> guard(connections[c]->lock);
+        close(connections[c]->fd);
+        connections[c]->fd = -1;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 4) {
+        std::cerr << "usage: iksolverd <rigs.iklb> [socket] [threads]" << std::endl;
+        return 2;
+    }
+
+    const char *path = (argc > 2) ? argv[2] : PROTO_SOCKET;
+    int threads = (argc > 3) ? atoi(argv[3]) : 0;
+
+    std::string error;
+    if (!library.open(argv[1], error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    rigs.assign(library.size(), NULL);
+    tuneOnce.reset(new std::once_flag[library.size()]);
+
+    int listener = listenUnix(path, error);
+    if (listener < 0) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    if (pipe(wakeFds) < 0) {
+        std::cerr << "can't create a pipe: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    {
+        ThreadPool pool(threads);
+        std::cout << "serving " << library.size() << " rigs on " << path << " with " <<
+            pool.size() << " threads" << std::endl;
+
+        serve(listener, pool);
+        pool.wait();
+    }
+
+    close(listener);
+    unlink(path);
+
+    ServiceStats final = snapshot();
+    std::cout << final.connections << " connections, " << final.requests << " requests, " <<
+        final.targets << " targets (" << final.expired << " expired), " << final.rejected <<
+        " rejected, " << final.stalls << " stalls" << std::endl <<
+        "latency us: p50 " << final.p50 << " p90 " << final.p90 << " p99 " << final.p99 <<
+        " max " << final.max << std::endl;
+
+    for (size_t r = 0; r < rigs.size(); r++)
+        delete rigs[r];
+    return 0;
+}
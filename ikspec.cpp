@@ -0,0 +1,175 @@
+#include <chrono>
+#include <math.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikspec.h"
+
+void TargetPredictor::observe(EndTarget target, double time) {
+    if (observed == 0) {
+        x = target.x;
+        y = target.y;
+        vx = vy = 0.f;
+        interval = 0.;
+    } else {
+        double dt = time - lastTime;
+        if (dt <= 0.)
+            dt = 1e-3;
+
+        interval = (observed == 1) ? dt : 0.8 * interval + 0.2 * dt;
+
+        if (type == PREDICT_LINEAR) {
+            vx = (target.x - x) / dt;
+            vy = (target.y - y) / dt;
+            x = target.x;
+            y = target.y;
+        } else {
+            // correct the constant velocity prediction by the residual
+            GLfloat px = x + vx * dt;
+            GLfloat py = y + vy * dt;
+            GLfloat rx = target.x - px;
+            GLfloat ry = target.y - py;
+
+            x = px + PREDICT_ALPHA * rx;
+            y = py + PREDICT_ALPHA * ry;
+            vx += PREDICT_BETA * rx / dt;
+            vy += PREDICT_BETA * ry / dt;
+
+            // the first velocity estimate comes from the first two targets
+            if (observed == 1) {
+                vx = rx / dt;
+                vy = ry / dt;
+            }
+        }
+    }
+
+    lastTime = time;
+    ++observed;
+}
+
+std::vector<EndTarget> TargetPredictor::predict(int count) {
+    std::vector<EndTarget> targets;
+    if (observed < 2)
+        return targets;
+
+    for (int k = 1; k <= count; k++) {
+        EndTarget t;
+        t.active = true;
+        t.x = x + vx * interval * k;
+        t.y = y + vy * interval * k;
+        targets.push_back(t);
+    }
+
+    return targets;
+}
+
+SpeculativeSolver::SpeculativeSolver(ThreadPool *p, PredictorType type) :
+    state(new State()), pool(p) {
+    predictor.type = type;
+}
+
+void SpeculativeSolver::reset() {
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->results.clear();
+        ++state->generation;
+    }
+
+    PredictorType type = predictor.type;
+    predictor = TargetPredictor();
+    predictor.type = type;
+}
+
+int SpeculativeSolver::solve(Skeleton &skel, EndTarget target, IKMethod method) {
+    GLfloat ex = target.x - skel.end.x;
+    GLfloat ey = target.y - skel.end.y;
+    GLfloat best = sqrtf(ex * ex + ey * ey);
+    Pose pose;
+    bool found = false;
+
+    // take the finished speculation nearest the real target, if it is
+    // closer than where the skeleton already is. anything still running
+    // belongs to the old generation and is thrown away when it finishes
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+
+        for (size_t i = 0; i < state->results.size(); i++) {
+            GLfloat dx = target.x - state->results[i].target.x;
+            GLfloat dy = target.y - state->results[i].target.y;
+            GLfloat dist = sqrtf(dx * dx + dy * dy);
+
+            if (dist < best) {
+                best = dist;
+                pose = state->results[i].pose;
+                found = true;
+            }
+        }
+
+        state->results.clear();
+        ++state->generation;
+    }
+
+    int iters = 0;
+    if (found) {
+        skel.setPose(pose);
+
+        GLfloat dx = target.x - skel.end.x;
+        GLfloat dy = target.y - skel.end.y;
+        if (sqrtf(dx * dx + dy * dy) < SPEC_TOLERANCE) {
+            ++hits;
+        } else {
+            ++warmStarts;
+            iters = skel.solveIK(target, method);
+        }
+    } else {
+        ++misses;
+        iters = skel.solveIK(target, method);
+    }
+
+    double now = std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    predictor.observe(target, now);
+
+    // without a pool nothing runs ahead
+    if (!pool)
+        return iters;
+
+    // solve the predicted targets from the pose we just reached
+    std::vector<EndTarget> next = predictor.predict(SPEC_AHEAD);
+    int generation = state->generation;
+
+    for (size_t i = 0; i < next.size(); i++) {
+        std::shared_ptr<State> shared = state;
+        Skeleton start = skel;
+        EndTarget predicted = next[i];
+
+        // the speculation already runs on the pool, a long parallel ccd
+        // chain mustn't wait on it again from inside
+        start.pool = NULL;
+
+        pool->submit([shared, start, predicted, method, generation]() {
+            {
+                std::lock_guard<std::mutex> guard(shared->lock);
+                if (shared->generation != generation)
+                    return;
+            }
+
+            Skeleton spec = start;
+            spec.solveIK(predicted, method);
+
+            Speculation result;
+            result.target = predicted;
+            result.pose = spec.getPose();
+
+            std::lock_guard<std::mutex> guard(shared->lock);
+            if (shared->generation == generation)
+                shared->results.push_back(result);
+        });
+    }
+
+    return iters;
+}
@@ -0,0 +1,82 @@
+/*
+ * ikspec.h
+ * ========
+ *
+ * speculative solving: predicts where the target is heading and solves
+ * those targets on idle cores before the real target arrives
+ *
+ */
+
+#ifndef _IKSPEC_H_
+#define _IKSPEC_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ikpool.h"
+#include "ikskel.h"
+
+// number of future targets solved ahead of the cursor
+#define SPEC_AHEAD 3
+
+// how close a speculated end effector must be to the real target to be
+// used as the answer without running the solver
+#define SPEC_TOLERANCE 0.005
+
+// gains of the alpha-beta (steady state kalman) predictor
+#define PREDICT_ALPHA 0.85
+#define PREDICT_BETA 0.005
+
+enum PredictorType { PREDICT_LINEAR, PREDICT_ALPHA_BETA };
+
+// constant velocity extrapolation of recent target positions
+struct TargetPredictor {
+    PredictorType type = PREDICT_ALPHA_BETA;
+
+    int observed = 0;
+    GLfloat x, y, vx, vy;
+
+    // time of the last target and the smoothed time between targets
+    double lastTime, interval;
+
+    void observe(EndTarget target, double time);
+
+    // the next count targets, one per expected event
+    std::vector<EndTarget> predict(int count);
+};
+
+struct Speculation {
+    EndTarget target;
+    Pose pose;
+};
+
+class SpeculativeSolver {
+ public:
+    SpeculativeSolver(ThreadPool *p, PredictorType type = PREDICT_ALPHA_BETA);
+
+    // solves skel for target, answered or warm started from a finished
+    // speculation when one is close, then speculates on the next targets.
+    // returns the iterations run on the calling thread
+    int solve(Skeleton &skel, EndTarget target, IKMethod method);
+
+    // forgets the speculations and target history, for a new skeleton
+    void reset();
+
+    // solves answered by a speculation, warm started by one, and neither
+    int hits = 0, warmStarts = 0, misses = 0;
+
+ private:
+    // shared with the background solves, which may outlive a solve() call
+    struct State {
+        std::mutex lock;
+        std::vector<Speculation> results;
+        int generation = 0;
+    };
+
+    std::shared_ptr<State> state;
+    TargetPredictor predictor;
+    ThreadPool *pool;
+};
+
+#endif
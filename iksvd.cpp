@@ -0,0 +1,114 @@
+#include <math.h>
+
+#include "iksvd.h"
+
+void svdJacobi(double *b, int m, int n, double *w, double *v) {
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            v[i * n + j] = (i == j) ? 1.0 : 0.0;
+
+    // rotate pairs of columns until they are all orthogonal
+    for (int sweep = 0; sweep < SVD_MAX_SWEEPS; sweep++) {
+        bool rotated = false;
+
+        for (int p = 0; p < n - 1; p++) {
+            for (int q = p + 1; q < n; q++) {
+                double alpha = 0.0, beta = 0.0, gamma = 0.0;
+                for (int k = 0; k < m; k++) {
+                    double bp = b[k * n + p];
+                    double bq = b[k * n + q];
+                    alpha += bp * bp;
+                    beta += bq * bq;
+                    gamma += bp * bq;
+                }
+
+                if (fabs(gamma) <= 1e-15 * sqrt(alpha * beta) || gamma == 0.0)
+                    continue;
+
+                rotated = true;
+
+                double zeta = (beta - alpha) / (2.0 * gamma);
+                double t = (zeta >= 0.0 ? 1.0 : -1.0) / (fabs(zeta) + sqrt(1.0 + zeta * zeta));
+                double c = 1.0 / sqrt(1.0 + t * t);
+                double s = c * t;
+
+                for (int k = 0; k < m; k++) {
+                    double bp = b[k * n + p];
+                    double bq = b[k * n + q];
+                    b[k * n + p] = c * bp - s * bq;
+                    b[k * n + q] = s * bp + c * bq;
+                }
+
+                for (int k = 0; k < n; k++) {
+                    double vp = v[k * n + p];
+                    double vq = v[k * n + q];
+                    v[k * n + p] = c * vp - s * vq;
+                    v[k * n + q] = s * vp + c * vq;
+                }
+            }
+        }
+
+        if (!rotated)
+            break;
+    }
+
+    // the singular values are the norms of the orthogonalized columns
+    for (int j = 0; j < n; j++) {
+        double norm = 0.0;
+        for (int k = 0; k < m; k++)
+            norm += b[k * n + j] * b[k * n + j];
+        w[j] = sqrt(norm);
+    }
+}
+
+int pseudoInverse(const double *a, int m, int n, double *ainv, double tol,
+        SVDWorkspace &work) {
+    // the jacobi sweeps are quadratic in the number of columns, so wide
+    // matrices are decomposed through their transpose
+    bool transposed = n > m;
+    int rows = transposed ? n : m;
+    int cols = transposed ? m : n;
+
+    work.b.resize(rows * cols);
+    work.v.resize(cols * cols);
+    work.w.resize(cols);
+
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            if (transposed)
+                work.b[j * cols + i] = a[i * n + j];
+            else
+                work.b[i * cols + j] = a[i * n + j];
+        }
+    }
+
+    svdJacobi(&work.b[0], rows, cols, &work.w[0], &work.v[0]);
+
+    // b now holds U * diag(w), so U / w = b / w^2
+    int rank = 0;
+    for (int j = 0; j < cols; j++) {
+        if (work.w[j] < tol) {
+            work.w[j] = 0.0;
+        } else {
+            work.w[j] = 1.0 / (work.w[j] * work.w[j]);
+            rank++;
+        }
+    }
+
+    // a = U S V^T gives a^+ = V S^-1 U^T, and for the transpose
+    // a^T = U S V^T gives a^+ = U S^-1 V^T
+    for (int i = 0; i < n; i++) {
+        for (int k = 0; k < m; k++) {
+            double total = 0.0;
+            for (int j = 0; j < cols; j++) {
+                if (transposed)
+                    total += work.b[i * cols + j] * work.w[j] * work.v[k * cols + j];
+                else
+                    total += work.v[i * cols + j] * work.w[j] * work.b[k * cols + j];
+            }
+            ainv[i * m + k] = total;
+        }
+    }
+
+    return rank;
+}
@@ -0,0 +1,37 @@
+/*
+ * iksvd.h
+ * =======
+ *
+ * zero based singular value decomposition (one-sided jacobi) and
+ * pseudoinverse working on row major arrays and reusable workspaces
+ *
+ */
+
+#ifndef _IKSVD_H_
+#define _IKSVD_H_
+
+#include <vector>
+
+// use this for tol in pseudoInverse(), singular values below it are dropped
+#define SVD_TOL 0.0001
+
+// maximum number of jacobi sweeps before giving up on convergence
+#define SVD_MAX_SWEEPS 30
+
+// scratch space kept between calls so repeated solves don't allocate
+struct SVDWorkspace {
+    std::vector<double> b, v, w;
+};
+
+// one-sided jacobi (hestenes) svd of the m x n row major matrix b, which
+// is overwritten with U * diag(w). v receives the n x n right singular
+// vectors (row major) and w the n singular values, in no particular order
+void svdJacobi(double *b, int m, int n, double *w, double *v);
+
+// pseudoinverse of the m x n row major matrix a into the n x m matrix
+// ainv, dropping singular values under tol. works on whichever of a or
+// its transpose has fewer columns. returns the rank
+int pseudoInverse(const double *a, int m, int n, double *ainv, double tol,
+        SVDWorkspace &work);
+
+#endif
@@ -0,0 +1,110 @@
+#include <math.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "iktraj.h"
+
+// number of segments each spline span is flattened into before sampling
+#define SPLINE_STEPS 16
+
+static EndTarget makeTarget(GLfloat x, GLfloat y) {
+    EndTarget t;
+    t.active = true;
+    t.x = x;
+    t.y = y;
+    return t;
+}
+
+// catmull-rom interpolation between p1 and p2
+static GLfloat catmullRom(GLfloat p0, GLfloat p1, GLfloat p2, GLfloat p3, GLfloat t) {
+    GLfloat t2 = t * t;
+    GLfloat t3 = t2 * t;
+
+    return 0.5f * ((2.f * p1) + (-p0 + p2) * t +
+            (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2 +
+            (-p0 + 3.f * p1 - 3.f * p2 + p3) * t3);
+}
+
+std::vector<EndTarget> sampleTargetPath(const std::vector<EndTarget> &points,
+        int count, PathType type) {
+    std::vector<EndTarget> samples;
+    if (points.empty() || count <= 0)
+        return samples;
+
+    // flatten the path into a dense polyline
+    std::vector<EndTarget> path;
+    if (type == PATH_SPLINE && points.size() > 2) {
+        int n = points.size();
+        for (int i = 0; i < n - 1; i++) {
+            const EndTarget &p0 = points[i > 0 ? i - 1 : 0];
+            const EndTarget &p1 = points[i];
+            const EndTarget &p2 = points[i + 1];
+            const EndTarget &p3 = points[i + 2 < n ? i + 2 : n - 1];
+
+            for (int s = 0; s < SPLINE_STEPS; s++) {
+                GLfloat t = (GLfloat)s / SPLINE_STEPS;
+                path.push_back(makeTarget(catmullRom(p0.x, p1.x, p2.x, p3.x, t),
+                            catmullRom(p0.y, p1.y, p2.y, p3.y, t)));
+            }
+        }
+        path.push_back(points.back());
+    } else {
+        path = points;
+    }
+
+    // cumulative arc length along the polyline
+    std::vector<GLfloat> dist(path.size(), 0.f);
+    for (size_t i = 1; i < path.size(); i++) {
+        GLfloat dx = path[i].x - path[i - 1].x;
+        GLfloat dy = path[i].y - path[i - 1].y;
+        dist[i] = dist[i - 1] + sqrtf(dx * dx + dy * dy);
+    }
+
+    // evenly space the samples by arc length
+    size_t seg = 1;
+    for (int i = 0; i < count; i++) {
+        GLfloat d = (count > 1) ? dist.back() * i / (count - 1) : 0.f;
+
+        while (seg < path.size() - 1 && dist[seg] < d)
+            ++seg;
+
+        if (path.size() == 1) {
+            samples.push_back(makeTarget(path[0].x, path[0].y));
+            continue;
+        }
+
+        GLfloat len = dist[seg] - dist[seg - 1];
+        GLfloat t = (len > 0.f) ? (d - dist[seg - 1]) / len : 0.f;
+        if (t > 1.f) t = 1.f;
+
+        samples.push_back(makeTarget(
+                    path[seg - 1].x + t * (path[seg].x - path[seg - 1].x),
+                    path[seg - 1].y + t * (path[seg].y - path[seg - 1].y)));
+    }
+
+    return samples;
+}
+
+std::vector<TrajectorySample> solveTrajectory(Skeleton skel,
+        const std::vector<EndTarget> &targets, IKMethod method) {
+    std::vector<TrajectorySample> samples(targets.size());
+
+    // solve each sample starting from the previous pose
+    for (size_t k = 0; k < targets.size(); k++) {
+        TrajectorySample &sample = samples[k];
+
+        sample.target = targets[k];
+        sample.iterations = skel.solveIK(targets[k], method);
+        sample.pose = skel.getPose();
+
+        GLfloat dx = sample.target.x - skel.end.x;
+        GLfloat dy = sample.target.y - skel.end.y;
+        sample.residual = sqrtf(dx * dx + dy * dy);
+    }
+
+    return samples;
+}
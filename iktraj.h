@@ -0,0 +1,38 @@
+/*
+ * iktraj.h
+ * ========
+ *
+ * solving a skeleton along a path of targets, each sample warm started
+ * from the pose of the previous one
+ *
+ */
+
+#ifndef _IKTRAJ_H_
+#define _IKTRAJ_H_
+
+#include <vector>
+
+#include "ikskel.h"
+
+enum PathType { PATH_POLYLINE, PATH_SPLINE };
+
+struct TrajectorySample {
+    EndTarget target;
+    Pose pose;
+
+    // distance from the solved end effector to the target and the
+    // solver iterations spent on this sample
+    GLfloat residual;
+    int iterations;
+};
+
+// evenly spaces count targets along the path through points, either
+// along its straight segments or along a catmull-rom spline
+std::vector<EndTarget> sampleTargetPath(const std::vector<EndTarget> &points,
+        int count, PathType type);
+
+// solves skel for every target in order, returning one sample per target
+std::vector<TrajectorySample> solveTrajectory(Skeleton skel,
+        const std::vector<EndTarget> &targets, IKMethod method);
+
+#endif
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <math.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikpool.h"
+#include "iktree.h"
+
+int TreeSkeleton::addJoint(int parent, GLfloat angle, GLfloat length, bool locked) {
+    joints.push_back(TreeJoint(parent, angle, length, locked));
+    positionJoint(joints.size() - 1);
+    dirty = true;
+    return joints.size() - 1;
+}
+
+int TreeSkeleton::addEffector(int joint) {
+    TreeEffector effector;
+    effector.joint = joint;
+    effector.target.x = joints[joint].end_x;
+    effector.target.y = joints[joint].end_y;
+    effectors.push_back(effector);
+    dirty = true;
+    return effectors.size() - 1;
+}
+
+void TreeSkeleton::lockJoint(int joint, bool locked) {
+    joints[joint].locked = locked;
+    dirty = true;
+}
+
+void TreeSkeleton::positionJoint(int joint) {
+    TreeJoint &bone = joints[joint];
+
+    if (bone.parent == TREE_ROOT) {
+        bone.x = root_x;
+        bone.y = root_y;
+        bone.heading = bone.angle;
+    } else {
+        const TreeJoint &parent = joints[bone.parent];
+        bone.x = parent.end_x;
+        bone.y = parent.end_y;
+        bone.heading = parent.heading + bone.angle;
+    }
+
+    GLfloat rad = bone.heading * M_PI / 180.f;
+    bone.end_x = bone.x + bone.length * cos(rad);
+    bone.end_y = bone.y + bone.length * sin(rad);
+}
+
+void TreeSkeleton::computePositions() {
+    // parents come before their children
+    for (size_t j = 0; j < joints.size(); j++)
+        positionJoint(j);
+}
+
+static int findSet(std::vector<int> &sets, int i) {
+    while (sets[i] != i)
+        i = sets[i] = sets[sets[i]];
+    return i;
+}
+
+void TreeSkeleton::buildGroups() {
+    int numJoints = joints.size();
+    int numEffectors = effectors.size();
+
+    // each effector depends on the unlocked joints between it and the root
+    std::vector<std::vector<int> > chains(numEffectors);
+    for (int e = 0; e < numEffectors; e++) {
+        for (int j = effectors[e].joint; j != TREE_ROOT; j = joints[j].parent) {
+            if (!joints[j].locked)
+                chains[e].push_back(j);
+        }
+        std::reverse(chains[e].begin(), chains[e].end());
+    }
+
+    // effectors sharing a joint have to be solved together
+    std::vector<int> sets(numEffectors);
+    std::vector<int> user(numJoints, -1);
+    for (int e = 0; e < numEffectors; e++) {
+        sets[e] = e;
+        for (int j : chains[e]) {
+            if (user[j] < 0)
+                user[j] = e;
+            else
+                sets[findSet(sets, e)] = findSet(sets, user[j]);
+        }
+    }
+
+    groups.clear();
+    std::vector<int> groupOf(numEffectors, -1);
+    for (int e = 0; e < numEffectors; e++) {
+        int set = findSet(sets, e);
+        if (groupOf[set] < 0) {
+            groupOf[set] = groups.size();
+            groups.push_back(TreeGroup());
+        }
+        groups[groupOf[set]].effectors.push_back(e);
+    }
+
+    // solved joints get a column in their group, numbered in tree order
+    std::vector<int> owner(numJoints, -1);
+    std::vector<int> column(numJoints, -1);
+    for (int j = 0; j < numJoints; j++) {
+        if (user[j] < 0)
+            continue;
+
+        TreeGroup &group = groups[groupOf[findSet(sets, user[j])]];
+        owner[j] = groupOf[findSet(sets, user[j])];
+        column[j] = group.joints.size();
+        group.joints.push_back(j);
+    }
+
+    // a bone moves with the nearest solved joint above it (or itself), and
+    // all of those belong to the same group, so groups never write the
+    // same bone
+    for (int j = 0; j < numJoints; j++) {
+        if (owner[j] < 0 && joints[j].parent != TREE_ROOT)
+            owner[j] = owner[joints[j].parent];
+        if (owner[j] >= 0)
+            groups[owner[j]].moved.push_back(j);
+    }
+
+    for (size_t g = 0; g < groups.size(); g++) {
+        TreeGroup &group = groups[g];
+        int count = group.effectors.size();
+
+        group.chainStart.assign(1, 0);
+        group.chain.clear();
+        for (int e : group.effectors) {
+            for (int j : chains[e])
+                group.chain.push_back(column[j]);
+            group.chainStart.push_back(group.chain.size());
+        }
+
+        // chains run from the root, so two of them share a prefix
+        group.shared.resize(count * count);
+        for (int a = 0; a < count; a++) {
+            for (int b = a; b < count; b++) {
+                int ia = group.chainStart[a], ea = group.chainStart[a + 1];
+                int ib = group.chainStart[b], eb = group.chainStart[b + 1];
+                int k = 0;
+                while (ia + k < ea && ib + k < eb && group.chain[ia + k] == group.chain[ib + k])
+                    ++k;
+                group.shared[a * count + b] = group.shared[b * count + a] = k;
+            }
+        }
+
+        group.jacobian.resize(2 * group.chain.size());
+    }
+
+    dirty = false;
+}
+
+void TreeSkeleton::buildJacobian(TreeGroup &group) {
+    int count = group.effectors.size();
+
+    // rows: x, y and (for oriented targets) the angle of every effector
+    group.rowStart.resize(count + 1);
+    group.rowStart[0] = 0;
+    for (int e = 0; e < count; e++) {
+        const EndTarget &target = effectors[group.effectors[e]].target;
+        group.rowStart[e + 1] = group.rowStart[e] + (target.oriented ? 3 : 2);
+    }
+
+    int m = group.rowStart[count];
+    group.v.resize(m);
+
+    for (int e = 0; e < count; e++) {
+        const TreeEffector &effector = effectors[group.effectors[e]];
+        const TreeJoint &tip = joints[effector.joint];
+        int row = group.rowStart[e];
+
+        group.v[row] = effector.target.x - tip.end_x;
+        group.v[row + 1] = effector.target.y - tip.end_y;
+        if (effector.target.oriented)
+            group.v[row + 2] = ORIENT_WEIGHT * clamp(fmod(effector.target.angle - tip.heading, 360.f)) * M_PI / 180.f;
+
+        // only the joints on the effector's chain have nonzero columns
+        for (int k = group.chainStart[e]; k < group.chainStart[e + 1]; k++) {
+            const TreeJoint &joint = joints[group.joints[group.chain[k]]];
+            group.jacobian[2 * k] = -(tip.end_y - joint.y);
+            group.jacobian[2 * k + 1] = tip.end_x - joint.x;
+        }
+    }
+
+    // J J^T block by block, each block summing over the shared prefix
+    group.jjt.resize(m * m);
+    for (int a = 0; a < count; a++) {
+        for (int b = 0; b < count; b++) {
+            int ra = group.rowStart[a], ma = group.rowStart[a + 1] - ra;
+            int rb = group.rowStart[b], mb = group.rowStart[b + 1] - rb;
+            int shared = group.shared[a * count + b];
+
+            double block[3][3] = { { 0.0 } };
+            for (int k = 0; k < shared; k++) {
+                double ja[3] = { group.jacobian[2 * (group.chainStart[a] + k)],
+                    group.jacobian[2 * (group.chainStart[a] + k) + 1], ORIENT_WEIGHT };
+                double jb[3] = { group.jacobian[2 * (group.chainStart[b] + k)],
+                    group.jacobian[2 * (group.chainStart[b] + k) + 1], ORIENT_WEIGHT };
+
+                for (int r = 0; r < ma; r++)
+                    for (int c = 0; c < mb; c++)
+                        block[r][c] += ja[r] * jb[c];
+            }
+
+            for (int r = 0; r < ma; r++)
+                for (int c = 0; c < mb; c++)
+                    group.jjt[(ra + r) * m + rb + c] = block[r][c];
+        }
+    }
+}
+
+int TreeSkeleton::solveGroup(TreeGroup &group) {
+    int count = group.effectors.size();
+
+    int i = 0;
+    while (i < NUM_JAC_ITERS) {
+        ++i;
+
+        buildJacobian(group);
+
+        // dtheta = J^T (J J^T)^+ v, scattered along each chain
+        int m = group.rowStart[count];
+        group.jjinverse.resize(m * m);
+        pseudoInverse(&group.jjt[0], m, m, &group.jjinverse[0], SVD_TOL, group.svd);
+
+        group.y.assign(m, 0.0);
+        for (int r = 0; r < m; r++)
+            for (int c = 0; c < m; c++)
+                group.y[r] += group.jjinverse[r * m + c] * group.v[c];
+
+        group.dtheta.assign(group.joints.size(), 0.0);
+        for (int e = 0; e < count; e++) {
+            int row = group.rowStart[e];
+            bool oriented = group.rowStart[e + 1] - row == 3;
+
+            for (int k = group.chainStart[e]; k < group.chainStart[e + 1]; k++) {
+                double step = group.jacobian[2 * k] * group.y[row] +
+                    group.jacobian[2 * k + 1] * group.y[row + 1];
+                if (oriented)
+                    step += ORIENT_WEIGHT * group.y[row + 2];
+                group.dtheta[group.chain[k]] += step;
+            }
+        }
+
+        std::vector<GLfloat> ox(count), oy(count);
+        for (int e = 0; e < count; e++) {
+            ox[e] = joints[effectors[group.effectors[e]].joint].end_x;
+            oy[e] = joints[effectors[group.effectors[e]].joint].end_y;
+        }
+
+        for (size_t c = 0; c < group.joints.size(); c++)
+            joints[group.joints[c]].angle += JT_ALPHA * group.dtheta[c] * 180 / M_PI;
+
+        for (int j : group.moved)
+            positionJoint(j);
+
+        // same stopping rule as the single chain, on the effector that
+        // moved the most
+        GLfloat step = 0.f;
+        for (int e = 0; e < count; e++) {
+            GLfloat sx = joints[effectors[group.effectors[e]].joint].end_x - ox[e];
+            GLfloat sy = joints[effectors[group.effectors[e]].joint].end_y - oy[e];
+            step = std::max(step, sqrtf(sx * sx + sy * sy));
+        }
+
+        if (step < JAC_EPSILON)
+            break;
+    }
+
+    return i;
+}
+
+int TreeSkeleton::solveIK(ThreadPool *pool) {
+    if (dirty)
+        buildGroups();
+
+    std::vector<int> iters(groups.size(), 0);
+
+    if (pool && groups.size() > 1) {
+        pool->parallelFor(0, groups.size(), [&](int begin, int end) {
+            for (int g = begin; g < end; g++)
+                iters[g] = solveGroup(groups[g]);
+        });
+    } else {
+        for (size_t g = 0; g < groups.size(); g++)
+            iters[g] = solveGroup(groups[g]);
+    }
+
+    return iters.empty() ? 0 : *std::max_element(iters.begin(), iters.end());
+}
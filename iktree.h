@@ -0,0 +1,106 @@
+/*
+ * iktree.h
+ * ========
+ *
+ * branching skeletons (a torso with arms, hands and fingers) with several
+ * end effectors, solved with a pseudoinverse over a jacobian stored per
+ * effector chain instead of as a dense rows x joints matrix. effectors
+ * that share no solvable joint form separate groups, which are solved
+ * independently and in parallel
+ *
+ */
+
+#ifndef _IKTREE_H_
+#define _IKTREE_H_
+
+#include <vector>
+
+#include "ikskel.h"
+#include "iksvd.h"
+
+// parent of the joints attached to the root
+#define TREE_ROOT -1
+
+struct TreeJoint {
+    int parent;
+
+    // locked joints keep their angle, so they split the effectors below
+    // them from the rest of the tree
+    bool locked;
+
+    // angle relative to the parent bone (or the x axis at the root)
+    GLfloat angle;
+    GLfloat length;
+
+    // base and tip of the bone, and its absolute angle, all filled in by
+    // computePositions()
+    GLfloat x, y;
+    GLfloat end_x, end_y;
+    GLfloat heading;
+
+    TreeJoint(int parent, GLfloat angle, GLfloat length, bool locked = false) :
+        parent(parent), locked(locked), angle(angle), length(length),
+        x(0.f), y(0.f), end_x(0.f), end_y(0.f), heading(0.f) { }
+};
+
+// an end effector at the tip of a joint, chasing its own target
+struct TreeEffector {
+    int joint;
+    EndTarget target;
+};
+
+// effectors that share solvable joints and everything needed to solve
+// them on their own. the jacobian is kept per effector: effector e of
+// the group depends on the joints chain[chainStart[e] .. chainStart[e+1])
+// (root first, as indices into joints), and the two position rows of
+// their columns are in jacobian[2k], jacobian[2k + 1]. two chains share
+// exactly their first shared[e * E + f] joints
+struct TreeGroup {
+    std::vector<int> effectors;
+    std::vector<int> joints;
+    std::vector<int> moved;
+
+    std::vector<int> chainStart, chain;
+    std::vector<int> shared;
+
+    std::vector<int> rowStart;
+    std::vector<double> jacobian, v, jjt, jjinverse, y, dtheta;
+    SVDWorkspace svd;
+};
+
+struct TreeSkeleton {
+    std::vector<TreeJoint> joints;
+    std::vector<TreeEffector> effectors;
+    std::vector<TreeGroup> groups;
+
+    GLfloat root_x = 0.f, root_y = 0.f;
+
+    // set when the groups no longer match the joints and effectors
+    bool dirty = true;
+
+    // parents have to be added before their children. both return the
+    // index of the new joint/effector
+    int addJoint(int parent, GLfloat angle, GLfloat length, bool locked = false);
+    int addEffector(int joint);
+    void lockJoint(int joint, bool locked);
+
+    void computePositions();
+
+    // splits the effectors into independent groups, done by solveIK()
+    // whenever joints or effectors changed
+    void buildGroups();
+
+    // moves every effector towards its target, one group per task when a
+    // pool is given. returns the iterations of the slowest group
+    int solveIK(ThreadPool *pool = NULL);
+
+    // places one bone at its parent's tip
+    void positionJoint(int joint);
+
+    // pseudoinverse iterations on one group until its effectors stall,
+    // touching only the bones the group moves. returns the iterations
+    int solveGroup(TreeGroup &group);
+    void buildJacobian(TreeGroup &group);
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "ikskel.h"
+#include "iktune.h"
+
+typedef std::chrono::steady_clock Clock;
+
+std::vector<EndTarget> sampleTargets(const Skeleton &skel, int count, unsigned seed, GLfloat spread) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<GLfloat> turn(-spread, spread);
+
+    Skeleton posed = skel;
+    Pose rest = posed.getPose();
+    Pose pose = rest;
+
+    std::vector<EndTarget> targets(count);
+    for (int t = 0; t < count; t++) {
+        for (size_t j = 0; j < pose.angles.size(); j++)
+            pose.angles[j] = clamp(rest.angles[j] + turn(rng));
+        posed.setPose(pose);
+
+        targets[t].active = true;
+        targets[t].x = posed.end.x;
+        targets[t].y = posed.end.y;
+    }
+
+    return targets;
+}
+
+Skeleton sampleChain(int joints) {
+    Skeleton skel;
+    skel.root_x = 0.f;
+    skel.root_y = 0.f;
+
+    for (int j = 0; j < joints; j++)
+        skel.joints.push_back(Joint(0.f, 0.f, j ? 10.f : 0.f, 0.8f / joints));
+
+    skel.computePositions();
+    skel.end.active = true;
+    skel.frozen = true;
+    return skel;
+}
+
+// every method, with step sizes and termination distances around the
+// defaults. the distances to the target are kept under the tolerance
+static std::vector<SolverConfig> candidates(double tolerance) {
+    const IKMethod reaching[] = { IK_CCD, IK_PARALLEL_CCD, IK_FABRIK };
+    const IKMethod stepping[] = { IK_TRANSPOSE, IK_PSEUDOINVERSE, IK_BROYDEN };
+    const double alphas[] = { 0.05, 0.2, 0.5, 1.0 };
+
+    std::vector<SolverConfig> configs;
+    for (IKMethod method : reaching) {
+        SolverConfig config(method);
+        config.iterations *= TUNE_ITER_SCALE;
+
+        config.epsilon = std::min(config.epsilon, tolerance);
+        configs.push_back(config);
+        config.epsilon = tolerance / 4;
+        configs.push_back(config);
+    }
+
+    for (IKMethod method : stepping) {
+        for (double alpha : alphas) {
+            // the transpose step isn't scaled to the error, large ones overshoot
+            if (method == IK_TRANSPOSE && alpha > 0.5)
+                continue;
+
+            SolverConfig config(method);
+            config.iterations *= TUNE_ITER_SCALE;
+            config.alpha = alpha;
+
+            configs.push_back(config);
+            config.epsilon *= 10;
+            configs.push_back(config);
+        }
+    }
+
+    return configs;
+}
+
+struct Trial {
+    double seconds = 0.0;
+    int reached = 0;
+    std::vector<int> iterations;
+    bool finished = true;
+};
+
+// solves every target from the starting pose, giving up once the time
+// spent passes budget
+static Trial runTrial(Skeleton &skel, const Pose &start, const std::vector<EndTarget> &targets,
+        const SolverConfig &config, double tolerance, double budget) {
+    Trial trial;
+
+    for (size_t t = 0; t < targets.size(); t++) {
+        skel.setPose(start);
+        skel.broyden = BroydenState();
+
+        Clock::time_point begin = Clock::now();
+        int iterations = skel.solveIK(targets[t], config);
+        trial.seconds += std::chrono::duration<double>(Clock::now() - begin).count();
+
+        GLfloat dx = targets[t].x - skel.end.x;
+        GLfloat dy = targets[t].y - skel.end.y;
+        if (sqrtf(dx * dx + dy * dy) <= tolerance) {
+            ++trial.reached;
+            trial.iterations.push_back(iterations);
+        }
+
+        if (trial.seconds > budget) {
+            trial.finished = false;
+            break;
+        }
+    }
+
+    return trial;
+}
+
+TuneReport tuneSkeleton(Skeleton &skel, double tolerance) {
+    return tuneSkeleton(skel, sampleTargets(skel), tolerance);
+}
+
+TuneReport tuneSkeleton(Skeleton &skel, const std::vector<EndTarget> &targets, double tolerance) {
+    TuneReport report;
+    if (skel.joints.empty() || targets.empty())
+        return report;
+
+    // solved on a copy, so skel keeps its pose and solver state
+    Skeleton work = skel;
+    Pose start = work.getPose();
+
+    std::vector<SolverConfig> configs = candidates(tolerance);
+    size_t needed = ceil(TUNE_SUCCESS * targets.size());
+
+    Trial best;
+    double budget = INFINITY;
+
+    for (size_t c = 0; c < configs.size(); c++) {
+        Trial trial = runTrial(work, start, targets, configs[c], tolerance, budget);
+        ++report.candidates;
+
+        if (!trial.finished) {
+            ++report.pruned;
+            continue;
+        }
+
+        bool good = (size_t)trial.reached >= needed;
+        bool better;
+        if (good)
+            better = !report.found || trial.seconds < best.seconds;
+        else
+            better = !report.found && (report.candidates == 1 || trial.reached > best.reached ||
+                (trial.reached == best.reached && trial.seconds < best.seconds));
+
+        if (better) {
+            best = trial;
+            report.config = configs[c];
+            report.found = good;
+        }
+
+        // once something meets the tolerance, slower candidates can stop
+        if (report.found)
+            budget = best.seconds;
+    }
+
+    // only a margin over what the successful solves needed, so targets
+    // it can't reach give up sooner. kept only if it still reaches as
+    // many of the samples
+    if (!best.iterations.empty()) {
+        std::sort(best.iterations.begin(), best.iterations.end());
+        size_t index = std::min(best.iterations.size() - 1, (size_t)(TUNE_SUCCESS * best.iterations.size()));
+        int limit = ceil(TUNE_MARGIN * best.iterations[index]);
+
+        SolverConfig trimmed = report.config;
+        trimmed.iterations = std::max(1, std::min(trimmed.iterations, limit));
+
+        Trial trial = runTrial(work, start, targets, trimmed, tolerance, INFINITY);
+        if (trial.reached >= best.reached) {
+            best = trial;
+            report.config = trimmed;
+        }
+    }
+
+    report.microseconds = 1e6 * best.seconds / targets.size();
+    report.reached = double(best.reached) / targets.size();
+
+    skel.autoConfig = report.config;
+    skel.autoTuned = true;
+    return report;
+}
@@ -0,0 +1,71 @@
+/*
+ * iktune.h
+ * ========
+ *
+ * picks the solver for a rig when it is frozen: candidate configurations
+ * (method, jacobian step size, termination distance) are timed solving
+ * sample targets from the rest pose, and the fastest one that reaches
+ * enough of them within the tolerance becomes the skeleton's autoConfig,
+ * which IK_AUTO solves dispatch to
+ *
+ */
+
+#ifndef _IKTUNE_H_
+#define _IKTUNE_H_
+
+#include <vector>
+
+#include "ikskel.h"
+
+// targets each candidate is timed on, and the seed they are drawn with
+#define TUNE_SAMPLES 48
+#define TUNE_SEED 3
+
+// how close a solve has to get to count, and the fraction of the samples
+// a configuration has to reach
+#define TUNE_TOLERANCE 0.01
+#define TUNE_SUCCESS 0.95
+
+// sample poses turn each joint up to this many degrees from rest
+#define TUNE_SPREAD 60.f
+
+// candidates run with this many times the default iteration limits. the
+// winner's limit is then cut down to TUNE_MARGIN times the iterations
+// its successful solves needed
+#define TUNE_ITER_SCALE 4
+#define TUNE_MARGIN 1.5
+
+struct TuneReport {
+    SolverConfig config;
+
+    // false if no candidate reached TUNE_SUCCESS of the samples, config
+    // is then the one that reached the most
+    bool found = false;
+
+    // of the chosen configuration: mean time per solve, and the fraction
+    // of the samples it reached
+    double microseconds = 0.0;
+    double reached = 0.0;
+
+    // candidates timed, and those given up on once they were slower than
+    // the best so far
+    int candidates = 0;
+    int pruned = 0;
+};
+
+// targets the rig can reach: the end effectors of random poses that turn
+// each joint up to spread degrees from its current one
+std::vector<EndTarget> sampleTargets(const Skeleton &skel, int count = TUNE_SAMPLES,
+        unsigned seed = TUNE_SEED, GLfloat spread = TUNE_SPREAD);
+
+// the frozen chain the benchmark and the harness profile: joints bones
+// 0.8 long in total, each turned 10 degrees from its parent
+Skeleton sampleChain(int joints);
+
+// profiles skel, from its current pose, on sampled targets or the ones
+// given, and stores the result in skel.autoConfig
+TuneReport tuneSkeleton(Skeleton &skel, double tolerance = TUNE_TOLERANCE);
+TuneReport tuneSkeleton(Skeleton &skel, const std::vector<EndTarget> &targets,
+        double tolerance = TUNE_TOLERANCE);
+
+#endif
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <ctime>
 #include <iostream>
 #include <list>
@@ -9,32 +10,51 @@
 #include <GL/glut.h>
 #endif
 
+#include "ikcollide.h"
+#include "iklib.h"
+#include "iklod.h"
+#include "ikring.h"
+#include "iksink.h"
+#include "ikmulti.h"
+#include "ikpool.h"
+#include "ikraster.h"
 #include "ikskel.h"
+#include "ikspec.h"
+#include "iktree.h"
+#include "iktune.h"
 
 // starting position for the window
 #define WINPOS_X 100
 #define WINPOS_Y 100
 
-// size of the displayed end effector
-#define END_SZE_X 0.025
-#define END_SZE_Y 0.025
+// joints moved per jacobian iteration with the active set on
+#define ACTIVE_SET_SIZE 8
 
-// width of the bone
-#define BONE_WIDTH 5
+// where 'w' saves the skeleton as a one rig library
+#define SAVE_PATH "skeleton.iklb"
 
-// radius of the joint markers
-#define JOINT_RAD 0.03
+// where 'r' records the solved poses
+#define RECORD_PATH "poses.ikps"
 
-// radius of the target marker
-#define TARGET_RAD 0.025
+// frames in the ring 'p' publishes poses to, and the fewest joints
+// each of its slots has room for
+#define RING_SLOTS 256
+#define RING_MIN_JOINTS 64
 
-// number of times we run CCD before termination
-#define NUM_CCD_ITERS 100
-#define NUM_JAC_ITERS 100
+// number of skeletons, one per IK method
+#define NUM_SKELETONS 7
 
-// how close we need to get to terminate CCD
-#define CCD_EPSILON 0.01
-#define JAC_EPSILON 0.0001
+// obstacles in the scene when collision aware solving is on
+#define NUM_OBSTACLES 3
+
+const GLfloat obstacles[NUM_OBSTACLES][3] = {
+    { 0.4f, 0.3f, 0.1f },
+    { -0.5f, -0.3f, 0.12f },
+    { 0.f, 0.6f, 0.08f }
+};
+
+// fingers on each hand of the tree rig
+#define RIG_FINGERS 5
 
 struct Window {
     int id = -1;
@@ -44,14 +64,57 @@ struct Window {
 
 Window win;
 
-// the skeleton holding joint pos/angle info
-Skeleton skeletonCCD;
-Skeleton skeletonIKT;
-Skeleton skeletonIKP;
+// the skeletons holding joint pos/angle info, one per IK method
+Skeleton skeletons[NUM_SKELETONS];
+
+// the method used to solve each skeleton, its methodColors entry is the
+// color it is drawn with
+const IKMethod skeletonMethods[NUM_SKELETONS] = {
+    IK_CCD, IK_TRANSPOSE, IK_PSEUDOINVERSE, IK_FABRIK, IK_BROYDEN, IK_PARALLEL_CCD, IK_AUTO
+};
+
+// the skeleton used to build and freeze the rest
+Skeleton &skeletonCCD = skeletons[0];
+
+// the skeleton solved with whatever was tuned for it when it was frozen
+Skeleton &skeletonAuto = skeletons[NUM_SKELETONS - 1];
 
 // the target we are trying to reach
 EndTarget target;
 
+// background solvers predicting where the target goes next
+ThreadPool *pool = NULL;
+SpeculativeSolver *speculators[NUM_SKELETONS];
+bool speculate = false;
+
+// solve coarse proxy chains before the full skeleton
+bool multiResolution = false;
+
+// solve from several perturbed poses and keep the best
+bool multiStart = false;
+
+// keep the skeletons out of themselves and the obstacles, one spatial
+// hash per skeleton
+CollisionWorld worlds[NUM_SKELETONS];
+bool collide = false;
+
+// streams every solved pose to RECORD_PATH, timestamps are microseconds
+// since the program started
+PoseSink recorder;
+std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+// publishes every solved pose to other processes through shared memory
+PoseRing publisher;
+
+// a torso with two arms and five fingered hands, the left hand chases
+// the target and the right one its mirror image. the torso is locked so
+// the arms are solved in parallel
+TreeSkeleton rig;
+bool showRig = false;
+
+// where each fingertip sits relative to its palm when the rig is built
+std::vector<std::pair<GLfloat, GLfloat> > rigOffsets;
+
 bool updateIK = false;
 
 __inline__ std::pair<GLfloat, GLfloat> toWorldSpace(int x, int y) {
@@ -137,6 +200,59 @@ void drawKinematicChain(Skeleton skel, GLfloat r, GLfloat g, GLfloat b) {
     // end drawing the kinematic chain
 }
 
+void buildRig() {
+    rig.root_x = 0.f;
+    rig.root_y = -0.6f;
+
+    int torso = rig.addJoint(TREE_ROOT, 90.f, 0.3f, true);
+
+    for (int side = 0; side < 2; side++) {
+        int joint = rig.addJoint(torso, side ? -100.f : 100.f, 0.2f);
+        joint = rig.addJoint(joint, side ? 20.f : -20.f, 0.2f);
+        int palm = rig.addJoint(joint, side ? 10.f : -10.f, 0.15f);
+
+        for (int f = 0; f < RIG_FINGERS; f++) {
+            int finger = rig.addJoint(palm, -40.f + 20.f * f, 0.05f);
+            finger = rig.addJoint(finger, 5.f, 0.04f);
+            finger = rig.addJoint(finger, 5.f, 0.03f);
+            rig.addEffector(finger);
+
+            rigOffsets.push_back(std::make_pair(rig.joints[finger].end_x - rig.joints[palm].end_x,
+                        rig.joints[finger].end_y - rig.joints[palm].end_y));
+        }
+    }
+}
+
+void drawTreeSkeleton(const TreeSkeleton &tree, GLfloat r, GLfloat g, GLfloat b) {
+    glPushMatrix();
+    glLoadIdentity();
+
+    // the bones already know where they are, no need for the matrix stack
+    for (size_t j = 0; j < tree.joints.size(); j++) {
+        const TreeJoint &joint = tree.joints[j];
+
+        glColor3f(r, g, b);
+        glBegin(GL_LINES);
+            glVertex2f(joint.x, joint.y);
+            glVertex2f(joint.end_x, joint.end_y);
+        glEnd();
+
+        // locked joints are grey
+        if (joint.locked)
+            glColor3f(0.5, 0.5, 0.5);
+        else
+            glColor3f(1.0, 1.0, 0.0);
+        glBegin(GL_TRIANGLE_FAN);
+        for (int i = 0; i <= 20; i++) {
+            glVertex2f(joint.x + (JOINT_RAD * cos(i * (2 * M_PI) / 20)),
+                    joint.y + (JOINT_RAD * sin(i * (2 * M_PI) / 20)));
+        }
+        glEnd();
+    }
+
+    glPopMatrix();
+}
+
 void display() {
     // display params
     glLineWidth(BONE_WIDTH);
@@ -147,9 +263,27 @@ void display() {
 
     glMatrixMode(GL_MODELVIEW);
 
-    if (skeletonCCD.active) drawKinematicChain(skeletonCCD, 1.f, 0.f, 0.f);
-    if (skeletonIKT.active) drawKinematicChain(skeletonIKT, 0.f, 1.f, 1.f);
-    if (skeletonIKP.active) drawKinematicChain(skeletonIKP, 1.f, 0.f, 1.f);
+    for (int i = 0; i < NUM_SKELETONS; i++) {
+        if (skeletons[i].active) {
+            const GLfloat *color = methodColors[skeletonMethods[i]];
+            drawKinematicChain(skeletons[i], color[0], color[1], color[2]);
+        }
+    }
+
+    if (showRig)
+        drawTreeSkeleton(rig, 0.f, 0.f, 1.f);
+
+    if (collide) {
+        glColor3f(0.5, 0.5, 0.5);
+        for (int o = 0; o < NUM_OBSTACLES; o++) {
+            glBegin(GL_TRIANGLE_FAN);
+            for (int i = 0; i <= 20; i++) {
+                glVertex2f(obstacles[o][0] + (obstacles[o][2] * cos(i * (2 * M_PI) / 20)),
+                        obstacles[o][1] + (obstacles[o][2] * sin(i * (2 * M_PI) / 20)));
+            }
+            glEnd();
+        }
+    }
 
     // draw the target if one exists
     if (target.active) {
@@ -189,63 +323,58 @@ void motion(int x, int y) {
             target.x = tars.first;
             target.y = tars.second;
 
-            if (skeletonIKP.active) {
-                using namespace std;
-                clock_t begin = clock();
-                for (int i = 0; i < NUM_JAC_ITERS; i++) {
-                    GLfloat ox = skeletonIKP.end.x;
-                    GLfloat oy = skeletonIKP.end.y;
-
-                    JacobianMethod method = PSEUDOINVERSE;
-                    skeletonIKP.solveIKwithJacobian(target, method);
+            for (int i = 0; i < NUM_SKELETONS; i++) {
+                if (!skeletons[i].active)
+                    continue;
 
-                    GLfloat dx = skeletonIKP.end.x - ox;
-                    GLfloat dy = skeletonIKP.end.y - oy;
-                    if (sqrtf(dx * dx + dy * dy) < JAC_EPSILON)
-                        break;
-                }
+                clock_t begin = clock();
+                int iters;
+                if (speculate)
+                    iters = speculators[i]->solve(skeletons[i], target, skeletonMethods[i]);
+                else if (multiResolution)
+                    iters = solveIKMultiResolution(skeletons[i], target, skeletonMethods[i]);
+                else if (multiStart)
+                    iters = solveIKMultiStart(skeletons[i], target, skeletonMethods[i], pool);
+                else if (collide)
+                    iters = solveIKCollisionAware(skeletons[i], target, skeletonMethods[i], worlds[i]);
+                else
+                    iters = skeletons[i].solveIK(target, skeletonMethods[i]);
                 clock_t end = clock();
                 double elapsed = double(end - begin) / CLOCKS_PER_SEC;
 
-                std::cout << "ik jacobian pseudoinverse took " << elapsed << " seconds" << std::endl;
+                GLfloat dx = target.x - skeletons[i].end.x;
+                GLfloat dy = target.y - skeletons[i].end.y;
+                std::cout << "ik " << methodName(skeletonMethods[i]) << " took " <<
+                    elapsed << " seconds (" << iters << " iterations, residual " <<
+                    sqrtf(dx * dx + dy * dy) << ", drift " << skeletons[i].drift << ", " <<
+                    skeletons[i].anchors << " re-anchors)" << std::endl;
+
+                uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - startTime).count();
+                if (recorder.isOpen())
+                    recorder.write(i, now, skeletons[i], target);
+                if (publisher.isOpen())
+                    publisher.publish(i, now, skeletons[i], target);
             }
+        }
 
-            if (skeletonIKT.active) {
-                using namespace std;
-                clock_t begin = clock();
-                for (int i = 0; i < NUM_JAC_ITERS; i++) {
-                    GLfloat ox = skeletonIKT.end.x;
-                    GLfloat oy = skeletonIKT.end.y;
-
-                    JacobianMethod method = TRANSPOSE;
-                    skeletonIKT.solveIKwithJacobian(target, method);
-
-                    GLfloat dx = skeletonIKT.end.x - ox;
-                    GLfloat dy = skeletonIKT.end.y - oy;
-                    if (sqrtf(dx * dx + dy * dy) < JAC_EPSILON)
-                        break;
-                }
-                clock_t end = clock();
-                double elapsed = double(end - begin) / CLOCKS_PER_SEC;
+        if (showRig) {
+            target.active = true;
+            target.x = tars.first;
+            target.y = tars.second;
 
-                std::cout << "ik jacobian transpose took " << elapsed << " seconds" << std::endl;
+            for (size_t e = 0; e < rig.effectors.size(); e++) {
+                GLfloat x = (e < RIG_FINGERS) ? target.x : -target.x;
+                rig.effectors[e].target.x = x + rigOffsets[e].first;
+                rig.effectors[e].target.y = target.y + rigOffsets[e].second;
             }
 
-            if (skeletonCCD.active) {
-                using namespace std;
-                clock_t begin = clock();
-                for (int i = 0; i < NUM_CCD_ITERS; i++) {
-                    skeletonCCD.solveIKwithCCD(target);
-                    GLfloat dx = target.x - skeletonCCD.end.x;
-                    GLfloat dy = target.y - skeletonCCD.end.y;
-                    if (sqrtf(dx * dx + dy * dy) < CCD_EPSILON)
-                        break;
-                }
-                clock_t end = clock();
-                double elapsed = double(end - begin) / CLOCKS_PER_SEC;
+            clock_t begin = clock();
+            int iters = rig.solveIK(pool);
+            double elapsed = double(clock() - begin) / CLOCKS_PER_SEC;
 
-                std::cout << "ik ccd took " << elapsed << " seconds" << std::endl;
-            }
+            std::cout << "ik tree rig took " << elapsed << " seconds (" << iters <<
+                " iterations, " << rig.groups.size() << " groups)" << std::endl;
         }
     }
 
@@ -262,17 +391,11 @@ void mouse(int button, int state, int x, int y) {
                 GLfloat newEndY = nars.second;
 
                 if (!skeletonCCD.end.active) {
-                    skeletonCCD.end.active = true;
-                    skeletonCCD.root_x = newEndX;
-                    skeletonCCD.root_y = newEndY;
-
-                    skeletonIKT.end.active = true;
-                    skeletonIKT.root_x = newEndX;
-                    skeletonIKT.root_y = newEndY;
-
-                    skeletonIKP.end.active = true;
-                    skeletonIKP.root_x = newEndX;
-                    skeletonIKP.root_y = newEndY;
+                    for (int i = 0; i < NUM_SKELETONS; i++) {
+                        skeletons[i].end.active = true;
+                        skeletons[i].root_x = newEndX;
+                        skeletons[i].root_y = newEndY;
+                    }
                 } else {
                     // create a new joint
                     GLfloat oldEndX = skeletonCCD.end.x;
@@ -301,21 +424,16 @@ void mouse(int button, int state, int x, int y) {
 
                     GLfloat length = sqrtf(v1 * v1 + v2 * v2);
 
-                    skeletonCCD.joints.push_back(Joint(oldEndX, oldEndY, angle, length));
-                    skeletonIKT.joints.push_back(Joint(oldEndX, oldEndY, angle, length));
-                    skeletonIKP.joints.push_back(Joint(oldEndX, oldEndY, angle, length));
+                    for (int i = 0; i < NUM_SKELETONS; i++)
+                        skeletons[i].joints.push_back(Joint(oldEndX, oldEndY, angle, length));
                     std::cout << "joint placed at " << oldEndX << "," << oldEndY <<
                         " w/ angle " << angle << " and length " << length << std::endl;
                 }
 
-                skeletonCCD.end.x = newEndX;
-                skeletonCCD.end.y = newEndY;
-
-                skeletonIKT.end.x = newEndX;
-                skeletonIKT.end.y = newEndY;
-
-                skeletonIKP.end.x = newEndX;
-                skeletonIKP.end.y = newEndY;
+                for (int i = 0; i < NUM_SKELETONS; i++) {
+                    skeletons[i].end.x = newEndX;
+                    skeletons[i].end.y = newEndY;
+                }
 
                 std::cout << "--" << std::endl;
 
@@ -333,27 +451,121 @@ void mouse(int button, int state, int x, int y) {
     glutPostRedisplay();
 }
 
+// profiles the frozen skeleton and keeps the fastest configuration for
+// the auto skeleton
+void tuneAutoSkeleton() {
+    if (!skeletonAuto.frozen)
+        return;
+
+    TuneReport report = tuneSkeleton(skeletonAuto);
+    std::cout << "auto-tuned: " << methodName(report.config.method) << ", step " <<
+        report.config.alpha << ", epsilon " << report.config.epsilon << ", " <<
+        report.config.iterations << " iterations (" << report.microseconds << " us per solve, " <<
+        100 * report.reached << "% of " << TUNE_SAMPLES << " samples within " << TUNE_TOLERANCE <<
+        (report.found ? "" : ", under the target rate") << ")" << std::endl;
+}
+
+// the solving modes don't compose, each one drives solveIK itself, so
+// turning one on turns the others off
+void toggleSolveMode(bool &mode, const char *name) {
+    mode = !mode;
+    std::cout << name << " solving " << (mode ? "on" : "off");
+
+    if (mode) {
+        bool *modes[] = { &speculate, &multiResolution, &multiStart, &collide };
+        const char *names[] = { "speculative", "multi-resolution", "multi-start", "collision aware" };
+        for (int i = 0; i < 4; i++) {
+            if (modes[i] != &mode && *modes[i]) {
+                *modes[i] = false;
+                std::cout << ", " << names[i] << " solving off";
+            }
+        }
+    }
+    std::cout << std::endl;
+}
+
 void keyboard(unsigned char key, int x, int y) {
     switch (key) {
-        case 49:
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7':
+            if (skeletons[key - '1'].frozen) {
+                skeletons[key - '1'].active = !skeletons[key - '1'].active;
+            }
+            break;
+
+        case 's':
+            toggleSolveMode(speculate, "speculative");
+            break;
+
+        case 'l':
+            toggleSolveMode(multiResolution, "multi-resolution");
+            break;
+
+        case 'k':
+            for (int i = 0; i < NUM_SKELETONS; i++)
+                skeletons[i].activeSetSize = skeletons[i].activeSetSize ? 0 : ACTIVE_SET_SIZE;
+            std::cout << "jacobian active set " << (skeletonCCD.activeSetSize ? "on" : "off") << std::endl;
+            break;
+
+        case 'w':
             if (skeletonCCD.frozen) {
-                skeletonCCD.active = !skeletonCCD.active;
+                std::vector<RigDescription> rigs(1, describeSkeleton(skeletonCCD));
+                if (writeSkeletonLibrary(SAVE_PATH, rigs))
+                    std::cout << "skeleton saved to " << SAVE_PATH << std::endl;
+                else
+                    std::cout << "can't write " << SAVE_PATH << std::endl;
             }
             break;
 
-        case 50:
-            if (skeletonIKT.frozen) {
-                skeletonIKT.active = !skeletonIKT.active;
+        case 'r':
+            if (recorder.isOpen()) {
+                recorder.close();
+                std::cout << "recorded " << recorder.records << " poses (" << recorder.bytes <<
+                    " bytes, " << recorder.dropped << " dropped) to " << RECORD_PATH << std::endl;
+            } else {
+                std::string error;
+                if (recorder.open(RECORD_PATH, true, false, error))
+                    std::cout << "recording poses to " << RECORD_PATH << std::endl;
+                else
+                    std::cout << error << std::endl;
             }
             break;
 
-        case 51:
-            if (skeletonIKP.frozen) {
-                skeletonIKP.active = !skeletonIKP.active;
+        case 'p':
+            if (publisher.isOpen()) {
+                publisher.close();
+                std::cout << "published " << publisher.frames << " poses to " << RING_NAME << std::endl;
+            } else {
+                std::string error;
+                int joints = std::max((int)skeletonCCD.joints.size(), RING_MIN_JOINTS);
+                if (publisher.create(RING_NAME, RING_SLOTS, joints, error))
+                    std::cout << "publishing poses to shared memory " << RING_NAME << std::endl;
+                else
+                    std::cout << error << std::endl;
             }
             break;
 
+        case 'c':
+            toggleSolveMode(collide, "collision aware");
+            break;
+
+        case 't':
+            showRig = !showRig;
+            std::cout << "tree rig " << (showRig ? "on" : "off") << std::endl;
+            break;
+
+        case 'm':
+            toggleSolveMode(multiStart, "multi-start");
+            break;
+
         case 27:        // ESC
+            recorder.close();
+            publisher.close();
             if (win.id) glutDestroyWindow(win.id);
             exit(0);
             break;
@@ -361,17 +573,15 @@ void keyboard(unsigned char key, int x, int y) {
         case 32:        // SPACE
             if (skeletonCCD.frozen) {
                 target.active = false;
-                skeletonCCD.resetSkeleton();
-                skeletonIKT.resetSkeleton();
-                skeletonIKP.resetSkeleton();
-
-                skeletonCCD.active = true;
-                skeletonIKT.active = false;
-                skeletonIKP.active = false;
+                for (int i = 0; i < NUM_SKELETONS; i++) {
+                    skeletons[i].resetSkeleton();
+                    skeletons[i].active = (i == 0);
+                    speculators[i]->reset();
+                }
             } else {
-                skeletonCCD.freezeSkeleton();
-                skeletonIKT.freezeSkeleton();
-                skeletonIKP.freezeSkeleton();
+                for (int i = 0; i < NUM_SKELETONS; i++)
+                    skeletons[i].freezeSkeleton();
+                tuneAutoSkeleton();
             }
             break;
     }
@@ -403,8 +613,39 @@ void reshape(GLsizei width, GLsizei height) {
 int main(int argc, char **argv) {
     skeletonCCD.active = true;
 
+    pool = new ThreadPool();
+    for (int i = 0; i < NUM_SKELETONS; i++) {
+        skeletons[i].pool = pool;
+        speculators[i] = new SpeculativeSolver(pool);
+
+        for (int o = 0; o < NUM_OBSTACLES; o++)
+            worlds[i].addObstacle(obstacles[o][0], obstacles[o][1], obstacles[o][2]);
+    }
+    buildRig();
+
     // initialize glut
     glutInit(&argc, argv);
+
+    // p1 <library> [rig] starts in IK mode with a rig from a library
+    if (argc > 1) {
+        SkeletonLibrary library;
+        std::string error;
+        RigView view;
+        int index = (argc > 2) ? atoi(argv[2]) : 0;
+
+        if (!library.open(argv[1], error)) {
+            std::cout << error << std::endl;
+        } else if (!library.rig(index, view) || view.count == 0) {
+            std::cout << argv[1] << " has no rig " << index << std::endl;
+        } else {
+            for (int i = 0; i < NUM_SKELETONS; i++) {
+                skeletons[i] = buildSkeleton(view);
+                skeletons[i].pool = pool;
+            }
+            skeletonCCD.active = true;
+            tuneAutoSkeleton();
+        }
+    }
     glutInitWindowPosition(WINPOS_X, WINPOS_Y);
     glutInitWindowSize(win.w, win.h);
     glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);